@@ -0,0 +1,350 @@
+/**
+ * @file    compute_attractor.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2016-2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef __COMPUTE_ATTRACTOR_HPP_INCLUDED
+#define __COMPUTE_ATTRACTOR_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "compute_lz77.hpp"
+
+
+//=============================================================================
+// Providers of the string attractor an st_att index is built on. An
+// attractor is a set of text positions such that every substring has an
+// occurrence containing one of them, and the index size grows with its
+// size gamma. Every provider works from the suffix array (and its inverse
+// and LCP array), returns the positions sorted and always includes
+// position 0, which the index maps the blocks before the text start to:
+//
+//   lz77       the ends of the LZ77 phrases, z positions,
+//   bwt_runs   the text positions of the first and last character of
+//              every BWT run, at most 2r positions [Kempa and Prezza,
+//              STOC 2018],
+//   lex_parse  the starts of the phrases of the lexicographic parse,
+//              where a phrase copies the longest common prefix with the
+//              lexicographically preceding suffix [Navarro, Ochoa and
+//              Prezza, IEEE TIT 2021],
+//   greedy     the smallest of the above, minimized by local search:
+//              attractors are dropped one by one as long as the rest is
+//              still an attractor.
+//=============================================================================
+
+namespace compute_attractor {
+
+enum attractor_type {
+  lz77,
+  bwt_runs,
+  lex_parse,
+  greedy
+};
+
+//=============================================================================
+// Name of the provider as used on the command line, and back.
+//=============================================================================
+inline const char *name(const attractor_type type) {
+  static const char * const names[] = { "lz77", "bwt", "lex", "greedy" };
+  return names[type];
+}
+
+inline bool parse(
+    const std::string &s,
+    attractor_type &type) {
+  for (std::uint64_t i = 0; i <= greedy; ++i) {
+    if (s == name((attractor_type)i)) {
+      type = (attractor_type)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+//=============================================================================
+// Compute the SA interval [beg..end] of text[start..start + length) by
+// exponential and binary search around isa[start] for an LCP value below
+// length. Takes no character comparisons.
+//=============================================================================
+template<
+  typename sa_offset_type,
+  typename rmq_type>
+void sa_interval(
+    const sa_offset_type * const isa,
+    const rmq_type &lcp_rmq,
+    const std::uint64_t text_length,
+    const std::uint64_t start,
+    const std::uint64_t length,
+    std::uint64_t &beg,
+    std::uint64_t &end) {
+  const std::uint64_t p = isa[start];
+  std::uint64_t lo = 0, hi = 1, mid;
+  while (hi <= p && !lcp_rmq.less(p - hi + 1, p + 1, length)) {
+    lo = hi;
+    hi <<= 1;
+  }
+  hi = std::min(hi, p + 1);
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (!lcp_rmq.less(p - mid + 1, p + 1, length))
+      lo = mid;
+    else
+      hi = mid;
+  }
+  beg = p - lo;
+  lo = 0;
+  hi = 1;
+  while (p + hi < text_length && !lcp_rmq.less(p + 1, p + hi + 1, length)) {
+    lo = hi;
+    hi <<= 1;
+  }
+  hi = std::min(hi, text_length - p);
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+    if (!lcp_rmq.less(p + 1, p + mid + 1, length))
+      lo = mid;
+    else
+      hi = mid;
+  }
+  end = p + lo;
+}
+
+//=============================================================================
+// Sort the positions, remove duplicates and add position 0.
+//=============================================================================
+template<typename text_offset_type>
+void normalize(std::vector<text_offset_type> &positions) {
+  positions.push_back(0);
+  std::sort(positions.begin(), positions.end());
+  positions.erase(std::unique(positions.begin(), positions.end()),
+      positions.end());
+}
+
+//=============================================================================
+// Ends of the LZ77 phrases.
+//=============================================================================
+template<
+  typename char_type,
+  typename sa_offset_type,
+  typename text_offset_type>
+void compute_lz77_ends(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const sa_offset_type * const sa,
+    std::vector<text_offset_type> &positions) {
+  std::vector<std::pair<sa_offset_type, sa_offset_type> > parsing;
+  compute_lz77::kkp2n(text, text_length, sa, parsing);
+  positions.clear();
+  std::uint64_t end = 0;
+  for (std::uint64_t i = 0; i < parsing.size(); ++i) {
+    end += std::max((std::uint64_t)parsing[i].second, (std::uint64_t)1);
+    positions.push_back(end - 1);
+  }
+  normalize(positions);
+}
+
+//=============================================================================
+// Text positions of the first and last character of every BWT run. The BWT
+// has a row for the empty suffix first, preceded by the last character of
+// the text. The character preceding the suffix at position 0 is a sentinel
+// that forms a run of its own and is not a text position.
+//=============================================================================
+template<
+  typename char_type,
+  typename sa_offset_type,
+  typename text_offset_type>
+void compute_bwt_runs(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const sa_offset_type * const sa,
+    std::vector<text_offset_type> &positions) {
+  const auto position = [&](std::uint64_t i) {
+    return (i == 0) ? (std::int64_t)text_length - 1 : (std::int64_t)sa[i - 1] - 1;
+  };
+  const auto bwt = [&](std::uint64_t i) {
+    return (position(i) < 0) ? -1 : (std::int64_t)text[position(i)];
+  };
+  positions.clear();
+  for (std::uint64_t i = 0; i <= text_length; ++i) {
+    if (position(i) < 0)
+      continue;
+    if (i == 0 || i == text_length ||
+        bwt(i - 1) != bwt(i) || bwt(i + 1) != bwt(i))
+      positions.push_back(position(i));
+  }
+  normalize(positions);
+}
+
+//=============================================================================
+// Starts of the phrases of the lexicographic parse. The phrase starting
+// at i has the length of the LCP of the suffix at i with the one before it
+// in the suffix array, or 1 if that is 0. lcp[i] is the LCP of the
+// suffixes sa[i - 1] and sa[i].
+//=============================================================================
+template<
+  typename sa_offset_type,
+  typename text_offset_type>
+void compute_lex_parse(
+    const std::uint64_t text_length,
+    const sa_offset_type * const isa,
+    const sa_offset_type * const lcp,
+    std::vector<text_offset_type> &positions) {
+  positions.clear();
+  for (std::uint64_t i = 0; i < text_length; ) {
+    positions.push_back(i);
+    const std::uint64_t rank = isa[i];
+    i += std::max((rank ? (std::uint64_t)lcp[rank] : 0), (std::uint64_t)1);
+  }
+  normalize(positions);
+}
+
+//=============================================================================
+// Drop attractors from the given attractor as long as the rest is still
+// one. Dropping a between its neighbours p and q only affects the
+// substrings that contain a and lie inside (p..q): with dist[r] the
+// distance from sa[r] to the next attractor, a substring of length m has
+// an occurrence containing an attractor iff the minimum of dist over its
+// SA interval is below m. The minimum is kept in a segment tree updated
+// when a is dropped. Attractors with more than max_checks such substrings
+// are kept without checking.
+//=============================================================================
+template<
+  typename sa_offset_type,
+  typename rmq_type,
+  typename text_offset_type>
+void minimize_greedy(
+    const std::uint64_t text_length,
+    const sa_offset_type * const isa,
+    const rmq_type &lcp_rmq,
+    std::vector<text_offset_type> &positions,
+    const std::uint64_t max_checks = 1024) {
+  const std::uint64_t n = text_length;
+  std::uint64_t size = 1;
+  while (size < n)
+    size <<= 1;
+  std::vector<std::uint64_t> tree(2 * size, n);
+  const auto update = [&](std::uint64_t x, std::uint64_t value) {
+    std::uint64_t i = size + isa[x];
+    tree[i] = value;
+    for (i >>= 1; i > 0; i >>= 1)
+      tree[i] = std::min(tree[2 * i], tree[2 * i + 1]);
+  };
+  const auto range_min = [&](std::uint64_t beg, std::uint64_t end) {
+    std::uint64_t result = n;
+    for (beg += size, end += size; beg < end; beg >>= 1, end >>= 1) {
+      if (beg & 1)
+        result = std::min(result, tree[beg++]);
+      if (end & 1)
+        result = std::min(result, tree[--end]);
+    }
+    return result;
+  };
+
+  // Compute the distances to the next attractor.
+  for (std::uint64_t x = n, next = n, k = positions.size(); x > 0; --x) {
+    if (k > 0 && (std::uint64_t)positions[k - 1] == x - 1)
+      next = positions[--k];
+    tree[size + isa[x - 1]] = next - (x - 1);
+  }
+  for (std::uint64_t i = size - 1; i > 0; --i)
+    tree[i] = std::min(tree[2 * i], tree[2 * i + 1]);
+
+  // Try to drop every attractor except position 0.
+  std::vector<text_offset_type> result(1, positions[0]);
+  for (std::uint64_t i = 1; i < positions.size(); ++i) {
+    const std::uint64_t p = result.back();
+    const std::uint64_t a = positions[i];
+    const std::uint64_t q = (i + 1 < positions.size()) ? positions[i + 1] : n;
+    if ((a - p) * (q - a) > max_checks) {
+      result.push_back(a);
+      continue;
+    }
+    for (std::uint64_t x = p + 1; x <= a; ++x)
+      update(x, q - x);
+    bool attractor = true;
+    for (std::uint64_t beg = p + 1; beg <= a && attractor; ++beg) {
+      for (std::uint64_t end = a + 1; end <= q && attractor; ++end) {
+        std::uint64_t sa_beg, sa_end;
+        sa_interval(isa, lcp_rmq, n, beg, end - beg, sa_beg, sa_end);
+        attractor = range_min(sa_beg, sa_end + 1) < end - beg;
+      }
+    }
+    if (!attractor) {
+      for (std::uint64_t x = p + 1; x <= a; ++x)
+        update(x, a - x);
+      result.push_back(a);
+    }
+  }
+  positions.swap(result);
+}
+
+//=============================================================================
+// Compute the attractor of the given type.
+//=============================================================================
+template<
+  typename char_type,
+  typename sa_offset_type,
+  typename rmq_type,
+  typename text_offset_type>
+void compute(
+    const attractor_type type,
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const sa_offset_type * const sa,
+    const sa_offset_type * const isa,
+    const sa_offset_type * const lcp,
+    const rmq_type &lcp_rmq,
+    std::vector<text_offset_type> &positions) {
+  if (type == lz77)
+    compute_lz77_ends(text, text_length, sa, positions);
+  else if (type == bwt_runs)
+    compute_bwt_runs(text, text_length, sa, positions);
+  else if (type == lex_parse)
+    compute_lex_parse(text_length, isa, lcp, positions);
+  else {
+    compute_lz77_ends(text, text_length, sa, positions);
+    std::vector<text_offset_type> other;
+    compute_bwt_runs(text, text_length, sa, other);
+    if (other.size() < positions.size())
+      positions.swap(other);
+    compute_lex_parse(text_length, isa, lcp, other);
+    if (other.size() < positions.size())
+      positions.swap(other);
+    minimize_greedy(text_length, isa, lcp_rmq, positions);
+  }
+}
+
+}  // namespace compute_attractor
+
+#endif  // __COMPUTE_ATTRACTOR_HPP_INCLUDED
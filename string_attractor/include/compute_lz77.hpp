@@ -36,6 +36,13 @@
 #include <cstdint>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <string>
+
+#include "utils.hpp"
+#include "uint40.hpp"
+#include "compute_sa.hpp"
+#include "parallel_utils.hpp"
 
 
 //=============================================================================
@@ -70,6 +77,23 @@ std::uint64_t parse_phrase(
     const char_type * const,
     std::vector<std::pair<text_offset_type, text_offset_type> > &);
 
+//=============================================================================
+// PSV scan step and parsing from PSV. Forward declarations.
+//=============================================================================
+template<typename psv_offset_type>
+void psv_step(psv_offset_type * const, std::uint64_t &, const std::uint64_t);
+
+template<
+  typename char_type,
+  typename text_offset_type,
+  typename psv_offset_type>
+void parse_with_psv(
+    const char_type * const,
+    const std::uint64_t,
+    psv_offset_type * const,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &,
+    const std::uint64_t = 0);
+
 //=============================================================================
 // Main parsing function.
 //=============================================================================
@@ -90,28 +114,60 @@ void kkp2n(
   text_offset_type *psv = new text_offset_type[text_length];
   {
     std::uint64_t prev_plus = 0;
-    for (std::uint64_t i = 0; i < text_length; ++i) {
-      const std::uint64_t cur = sa[i];
-      while (prev_plus > 0 && prev_plus - 1 > cur) {
-        const std::uint64_t j = prev_plus - 1;
-        prev_plus = ((std::uint64_t)psv[j] == j) ?
-          (std::uint64_t)0 : (std::uint64_t)psv[j] + 1;
-      }
-      psv[cur] = (prev_plus == 0) ? cur : prev_plus - 1;
-      prev_plus = cur + 1;
-    }
+    for (std::uint64_t i = 0; i < text_length; ++i)
+      psv_step(psv, prev_plus, sa[i]);
   }
 
   // Compute LZ77 phrases using the PSV values.
-  // NSV values are computed on the fly from PSV.
+  parse_with_psv(text, text_length, psv, parsing);
+
+  // Clean up.
+  delete[] psv;
+}
+
+//=============================================================================
+// Process the next SA element cur in the computation of the PSV array.
+// The stack of the scan is stored in psv itself, prev_plus is one more
+// than its top or 0 if it is empty.
+//=============================================================================
+template<typename psv_offset_type>
+void psv_step(
+    psv_offset_type * const psv,
+    std::uint64_t &prev_plus,
+    const std::uint64_t cur) {
+  while (prev_plus > 0 && prev_plus - 1 > cur) {
+    const std::uint64_t j = prev_plus - 1;
+    prev_plus = ((std::uint64_t)psv[j] == j) ?
+      (std::uint64_t)0 : (std::uint64_t)psv[j] + 1;
+  }
+  psv[cur] = (prev_plus == 0) ? cur : prev_plus - 1;
+  prev_plus = cur + 1;
+}
+
+//=============================================================================
+// Compute LZ77 phrases using the PSV values. NSV values are computed on
+// the fly from PSV, which is overwritten in the process. Only the suffix
+// text[first..text_length) is parsed, with sources anywhere before.
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type,
+  typename psv_offset_type>
+void parse_with_psv(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    psv_offset_type * const psv,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &parsing,
+    const std::uint64_t first) {
   {
-    parsing.push_back(
-        std::make_pair(
-          (text_offset_type)text[0],
-          (text_offset_type)0));
-    std::uint64_t next = 1;
+    if (first == 0)
+      parsing.push_back(
+          std::make_pair(
+            (text_offset_type)text[0],
+            (text_offset_type)0));
+    std::uint64_t next = std::max(first, (std::uint64_t)1);
     std::uint64_t list_head = 0;
-    text_offset_type *invphi = psv;
+    psv_offset_type *invphi = psv;
     for (std::uint64_t i = 1; i < text_length; ++i) {
       const std::uint64_t psv_pos = psv[i];
       std::uint64_t nsv_pos = i;
@@ -133,9 +189,295 @@ void kkp2n(
         next = parse_phrase(i, text_length, psv_pos, nsv_pos, text, parsing);
     }
   }
+}
+
+//=============================================================================
+// Low-memory version of kkp2n with the same output. The SA is computed
+// with sa_offset_type entries and written to sa_filename, then streamed
+// back while the PSV array is filled in the buffer of the SA, so the SA
+// and PSV are never in memory together. Excluding the text and the output
+// parsing, the peak memory is n * sizeof(sa_offset_type) bytes for the
+// in-place instantiations of compute_sa. The file takes
+// n * sizeof(psv_offset_type) bytes and is deleted before returning. If
+// first > 0, only text[first..) is parsed (see parse_with_psv).
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type,
+  typename sa_offset_type,
+  typename psv_offset_type>
+void kkp2n_low_memory(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &parsing,
+    const std::string sa_filename,
+    const std::uint64_t first = 0) {
+
+  // Handle special case.
+  if (text_length == 0)
+    return;
+
+  // Compute the SA and write it to disk.
+  static_assert(sizeof(psv_offset_type) <= sizeof(sa_offset_type),
+      "the PSV array must fit in the buffer of the SA");
+  static const std::uint64_t buffer_size = (1UL << 20);
+  psv_offset_type * const buffer = new psv_offset_type[buffer_size];
+  sa_offset_type * const sa = new sa_offset_type[text_length];
+  {
+    compute_sa(text, text_length, sa);
+    std::FILE * const f = utils::file_open_nobuf(sa_filename, "w");
+    for (std::uint64_t beg = 0; beg < text_length; beg += buffer_size) {
+      const std::uint64_t end = std::min(text_length, beg + buffer_size);
+      for (std::uint64_t i = beg; i < end; ++i)
+        buffer[i - beg] = (std::uint64_t)sa[i];
+      utils::write_to_file(buffer, end - beg, f);
+    }
+    std::fclose(f);
+  }
+
+  // Compute the PSV array from the streamed SA.
+  void * const sa_buffer = sa;
+  psv_offset_type * const psv = (psv_offset_type *)sa_buffer;
+  {
+    std::FILE * const f = utils::file_open_nobuf(sa_filename, "r");
+    std::uint64_t prev_plus = 0;
+    for (std::uint64_t beg = 0; beg < text_length; beg += buffer_size) {
+      const std::uint64_t end = std::min(text_length, beg + buffer_size);
+      utils::read_from_file(buffer, end - beg, f);
+      for (std::uint64_t i = beg; i < end; ++i)
+        psv_step(psv, prev_plus, (std::uint64_t)buffer[i - beg]);
+    }
+    std::fclose(f);
+    utils::file_delete(sa_filename);
+  }
+  delete[] buffer;
+
+  // Compute LZ77 phrases using the PSV values.
+  parse_with_psv(text, text_length, psv, parsing, first);
+
+  // Clean up.
+  delete[] sa;
+}
+
+//=============================================================================
+// Run kkp2n_low_memory with 32-bit SA and PSV entries if the text is short
+// enough for the 32-bit SA-IS, and with 40-bit ones otherwise. Excluding
+// the output parsing, the peak memory is then 5n or 6n bytes.
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type>
+void kkp2n_low_memory(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &parsing,
+    const std::string sa_filename) {
+  if (text_length < (1UL << 31))
+    kkp2n_low_memory<char_type, text_offset_type, std::uint32_t,
+      std::uint32_t>(text, text_length, parsing, sa_filename);
+  else kkp2n_low_memory<char_type, text_offset_type, uint40,
+      uint40>(text, text_length, parsing, sa_filename);
+}
+
+//=============================================================================
+// External-memory parsing of the text stored in text_filename. The text is
+// read in windows of window_length characters and the characters not in
+// the first window_length / 2 of a window (the history) are parsed with
+// kkp2n_low_memory, using sources in the window. Consecutive windows
+// overlap by the history, so this is the LZ77 parsing with a sliding
+// window: every source is within window_length / 2 characters of its
+// phrase and phrases are cut at window ends. It equals the LZ77 parsing if
+// the text fits in one window. Excluding the output parsing, the peak
+// memory is about 9 * window_length bytes: the window and its 32-bit SA,
+// then the window and its 32-bit PSV, plus a 4 MiB SA buffer.
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type>
+void em_kkp2n(
+    const std::string text_filename,
+    const std::uint64_t text_length,
+    const std::uint64_t window_length,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &parsing,
+    const std::string sa_filename) {
+  const std::uint64_t window = std::max((std::uint64_t)2,
+      std::min(window_length, (std::uint64_t)(1UL << 31) - 1));
+  const std::uint64_t history = window / 2;
+  char_type * const buffer = new char_type[window];
+  std::vector<std::pair<text_offset_type, text_offset_type> > phrases;
+  for (std::uint64_t beg = 0; beg < text_length; ) {
+    const std::uint64_t window_beg = (beg > history) ? beg - history : 0;
+    const std::uint64_t window_end = std::min(text_length, window_beg + window);
+    utils::read_at_offset(buffer, window_beg * sizeof(char_type),
+        window_end - window_beg, text_filename);
+    phrases.clear();
+    kkp2n_low_memory<char_type, text_offset_type, std::uint32_t,
+      std::uint32_t>(buffer, window_end - window_beg, phrases, sa_filename,
+          beg - window_beg);
+    for (std::uint64_t i = 0; i < phrases.size(); ++i) {
+      if ((std::uint64_t)phrases[i].second > 0)
+        phrases[i].first = (std::uint64_t)phrases[i].first + window_beg;
+      parsing.push_back(phrases[i]);
+    }
+    beg = window_end;
+  }
+  delete[] buffer;
+}
+
+//=============================================================================
+// For every suffix, compute the text positions of the nearest suffixes
+// before it (psv) and after it (nsv) in the suffix array that start
+// earlier in the text, or its own position if there is none. The SA is
+// cut into one chunk per thread and every chunk is scanned with a stack:
+// an element gets its psv when it is pushed and its nsv when it is popped.
+// The psv values missing inside a chunk belong to its prefix minima and are
+// found in the stack left after the nearest chunk before it with a smaller
+// minimum. Symmetrically, the nsv values missing are those of the elements
+// left on the stack, found among the prefix minima of the nearest chunk
+// after it with a smaller minimum. The chunks searched move monotonically,
+// so the fix-up takes one pass over the chunks per chunk.
+//=============================================================================
+template<typename text_offset_type>
+void nearest_smaller_values(
+    const text_offset_type * const sa,
+    const std::uint64_t text_length,
+    text_offset_type * const psv,
+    text_offset_type * const nsv,
+    const std::uint64_t n_threads) {
+  const std::uint64_t n = text_length;
+  const std::uint64_t n_chunks = std::max(n_threads, (std::uint64_t)1);
+  const std::uint64_t chunk_length = (n + n_chunks - 1) / n_chunks;
+  std::vector<std::vector<std::uint64_t> > stacks(n_chunks);
+  std::vector<std::vector<std::uint64_t> > minima(n_chunks);
+
+  // Compute the values inside every chunk.
+  parallel_utils::parallel_for(0, n_chunks, n_threads,
+      [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+        for (std::uint64_t c = beg; c < end; ++c) {
+          std::vector<std::uint64_t> &stack = stacks[c];
+          const std::uint64_t chunk_end = std::min(n, (c + 1) * chunk_length);
+          for (std::uint64_t k = c * chunk_length; k < chunk_end; ++k) {
+            const std::uint64_t v = sa[k];
+            while (!stack.empty() && stack.back() > v) {
+              nsv[stack.back()] = v;
+              stack.pop_back();
+            }
+            if (stack.empty())
+              minima[c].push_back(v);
+            else psv[v] = stack.back();
+            stack.push_back(v);
+          }
+        }
+      });
+
+  // Fix up the prefix minima and the stack of every chunk.
+  parallel_utils::parallel_for(0, n_chunks, n_threads,
+      [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+        for (std::uint64_t c = beg; c < end; ++c) {
+          std::int64_t d = (std::int64_t)c - 1;
+          for (std::uint64_t i = 0; i < minima[c].size(); ++i) {
+            const std::uint64_t v = minima[c][i];
+            while (d >= 0 && (stacks[d].empty() || stacks[d][0] > v))
+              --d;
+            if (d < 0)
+              psv[v] = v;
+            else psv[v] = *(std::lower_bound(stacks[d].begin(),
+                  stacks[d].end(), v) - 1);
+          }
+          d = c + 1;
+          for (std::uint64_t i = stacks[c].size(); i > 0; --i) {
+            const std::uint64_t v = stacks[c][i - 1];
+            while (d < (std::int64_t)n_chunks &&
+                (minima[d].empty() || minima[d].back() > v))
+              ++d;
+            if (d == (std::int64_t)n_chunks)
+              nsv[v] = v;
+            else nsv[v] = *std::lower_bound(minima[d].begin(), minima[d].end(),
+                v, std::greater<std::uint64_t>());
+          }
+        }
+      });
+}
+
+//=============================================================================
+// Parallel version of kkp2n with the same output. The PSV and NSV arrays
+// are computed with nearest_smaller_values. The text is then cut into one chunk
+// per thread and every chunk is parsed greedily from its start, which
+// only depends on the PSV and NSV of the phrase starts. Finally the
+// chunks are joined: the parsing coming from the chunk before continues
+// on its own until it reaches a phrase start of the chunk, after which
+// the phrases of the chunk are taken. Uses 2n words of working space.
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type>
+void parallel_kkp2n(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const text_offset_type * const sa,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &parsing,
+    const std::uint64_t n_threads) {
+  typedef std::pair<text_offset_type, text_offset_type> pair_type;
+
+  // Handle special case.
+  if (text_length == 0)
+    return;
+
+  // Compute the PSV and NSV arrays.
+  text_offset_type * const psv = new text_offset_type[text_length];
+  text_offset_type * const nsv = new text_offset_type[text_length];
+  nearest_smaller_values(sa, text_length, psv, nsv, n_threads);
+
+  // Parse every chunk from its start.
+  const std::uint64_t n_chunks = std::max(n_threads, (std::uint64_t)1);
+  const std::uint64_t chunk_length = (text_length + n_chunks - 1) / n_chunks;
+  std::vector<std::vector<pair_type> > phrases(n_chunks);
+  std::vector<std::vector<std::uint64_t> > starts(n_chunks);
+  std::vector<std::uint64_t> ends(n_chunks);
+  parallel_utils::parallel_for(0, n_chunks, n_threads,
+      [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+        for (std::uint64_t c = beg; c < end; ++c) {
+          std::uint64_t i = std::min(text_length, c * chunk_length);
+          const std::uint64_t chunk_end =
+            std::min(text_length, (c + 1) * chunk_length);
+          if (i == 0) {
+            starts[c].push_back(0);
+            phrases[c].push_back(std::make_pair(
+                  (text_offset_type)text[0], (text_offset_type)0));
+            i = 1;
+          }
+          while (i < chunk_end) {
+            starts[c].push_back(i);
+            i = parse_phrase(i, text_length, (std::uint64_t)psv[i],
+                (std::uint64_t)nsv[i], text, phrases[c]);
+          }
+          ends[c] = i;
+        }
+      });
+
+  // Join the chunks.
+  std::uint64_t next = 0;
+  for (std::uint64_t c = 0; c < n_chunks; ++c) {
+    const std::uint64_t chunk_end =
+      std::min(text_length, (c + 1) * chunk_length);
+    std::vector<std::uint64_t>::const_iterator it = starts[c].cbegin();
+    while (next < chunk_end) {
+      it = std::lower_bound(it, starts[c].cend(), next);
+      if (it != starts[c].cend() && *it == next) {
+        parsing.insert(parsing.end(),
+            phrases[c].begin() + (it - starts[c].cbegin()), phrases[c].end());
+        next = ends[c];
+        break;
+      }
+      next = parse_phrase(next, text_length, (std::uint64_t)psv[next],
+          (std::uint64_t)nsv[next], text, parsing);
+    }
+    std::vector<pair_type>().swap(phrases[c]);
+  }
 
   // Clean up.
   delete[] psv;
+  delete[] nsv;
 }
 
 //=============================================================================
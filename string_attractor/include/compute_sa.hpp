@@ -36,16 +36,21 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 
 #include "uint40.hpp"
 #include "uint48.hpp"
 #include "sais.hxx"
 #include "naive_compute_sa.hpp"
+#include "parallel_compute_sa.hpp"
 
 
 //=============================================================================
 // Compute SA of a given text[0..text_length)
-// and write to sa[0..text_length).
+// and write to sa[0..text_length). With one thread (the default) the
+// SA is computed with the sequential SA-IS, otherwise with the parallel
+// prefix doubling from parallel_compute_sa.hpp, falling back to SA-IS on
+// texts with long repeats.
 //=============================================================================
 template<
   typename char_type,
@@ -53,7 +58,8 @@ template<
 void compute_sa(
     const char_type * const text,
     const std::uint64_t text_length,
-    text_offset_type * const sa) {
+    text_offset_type * const sa,
+    const std::uint64_t = 1) {
 
   naive_compute_sa(text, text_length, sa);
 }
@@ -67,7 +73,13 @@ template<>
 void compute_sa(
     const std::uint8_t * const text,
     const std::uint64_t text_length,
-    std::uint32_t * const sa) {
+    std::uint32_t * const sa,
+    const std::uint64_t n_threads) {
+
+  // Run parallel prefix doubling, or sais if it gives up.
+  if (n_threads > 1 &&
+      parallel_compute_sa(text, text_length, sa, n_threads))
+    return;
 
   // Run sais.
   saisxx<const std::uint8_t *, std::int32_t*, std::int32_t>(
@@ -83,7 +95,13 @@ template<>
 void compute_sa(
     const std::uint8_t * const text,
     const std::uint64_t text_length,
-    std::uint64_t * const sa) {
+    std::uint64_t * const sa,
+    const std::uint64_t n_threads) {
+
+  // Run parallel prefix doubling, or sais if it gives up.
+  if (n_threads > 1 &&
+      parallel_compute_sa(text, text_length, sa, n_threads))
+    return;
 
   // Run sais.
   saisxx<const std::uint8_t *, std::int64_t*, std::int64_t>(text,
@@ -91,15 +109,101 @@ void compute_sa(
 }
 
 //=============================================================================
-// Instantiation (not space efficient) of compute_sa for
-// text_offset_type == uint40 and char_type == std::uint8_t.
+// Widen the 32-bit SA stored at the beginning of the buffer of sa into
+// text_offset_type entries, from the back so that every 32-bit entry is
+// read before it is overwritten.
+//=============================================================================
+template<typename text_offset_type>
+void widen_sa_in_place(
+    text_offset_type * const sa,
+    const std::uint64_t text_length) {
+  const std::uint8_t * const sa32 = (const std::uint8_t *)sa;
+  for (std::uint64_t i = text_length; i > 0; --i) {
+    std::uint32_t value = 0;
+    std::memcpy(&value, sa32 + (i - 1) * sizeof(std::uint32_t),
+        sizeof(std::uint32_t));
+    sa[i - 1] = value;
+  }
+}
+
+//=============================================================================
+// Signed integer with the layout of uint40 (high_type == std::int8_t) or
+// uint48 (high_type == std::int16_t). SA-IS needs signed entries, so it
+// runs on this type when it sorts directly in a uint40 or uint48 buffer.
+// Non-negative values have the same bytes in both types.
+//=============================================================================
+template<typename high_type>
+class packed_int {
+  private:
+    std::uint32_t low;
+    high_type high;
+
+  public:
+    packed_int() {}
+    packed_int(const packed_int& a) : low(a.low), high(a.high) {}
+    packed_int(const std::int64_t& a) :
+      low(a & 0xFFFFFFFFL), high((high_type)(a >> 32)) {}
+
+    inline packed_int& operator = (const packed_int& a) {
+      low = a.low; high = a.high; return *this; }
+    inline packed_int& operator += (const std::int64_t& a) {
+      return *this = (std::int64_t)*this + a; }
+    inline packed_int& operator -= (const std::int64_t& a) {
+      return *this = (std::int64_t)*this - a; }
+    inline packed_int& operator ++ () { return *this += 1; }
+    inline packed_int& operator -- () { return *this -= 1; }
+
+    inline operator std::int64_t() const {
+      return (std::int64_t)((std::uint64_t)(std::int64_t)high << 32) |
+        (std::int64_t)low; }
+} __attribute__((packed));
+
+//=============================================================================
+// Compute the SA of text[0..text_length) with SA-IS directly in the buffer
+// of sa, whose entries are read as signed_type. Needs no space besides sa.
+// SA-IS temporarily stores values up to 2 * text_length, so signed_type
+// must hold them.
+//=============================================================================
+template<
+  typename signed_type,
+  typename text_offset_type>
+void compute_sa_in_place(
+    const std::uint8_t * const text,
+    const std::uint64_t text_length,
+    text_offset_type * const sa) {
+  void * const buffer = sa;
+  saisxx<const std::uint8_t *, signed_type *, std::int64_t>(text,
+      (signed_type *)buffer, (std::int64_t)text_length);
+}
+
+//=============================================================================
+// Instantiation of compute_sa for text_offset_type == uint40 and
+// char_type == std::uint8_t. Texts shorter than 2^31 are sorted with 32-bit
+// entries in the buffer of sa and widened in place. Longer ones are sorted
+// with the parallel prefix doubling directly on sa if n_threads > 1, and
+// otherwise (or if it gives up) with signed 40-bit entries in place up to
+// 2^38 (see compute_sa_in_place) and with a temporary 64-bit SA beyond that.
 //=============================================================================
 template<>
 void compute_sa(
     const std::uint8_t * const text,
     const std::uint64_t text_length,
-    uint40 * const sa) {
+    uint40 * const sa,
+    const std::uint64_t n_threads) {
 
+  if (text_length < (1UL << 31)) {
+    void * const buffer = sa;
+    compute_sa(text, text_length, (std::uint32_t *)buffer, n_threads);
+    widen_sa_in_place(sa, text_length);
+    return;
+  }
+  if (n_threads > 1 &&
+      parallel_compute_sa(text, text_length, sa, n_threads))
+    return;
+  if (text_length < (1UL << 38)) {
+    compute_sa_in_place<packed_int<std::int8_t> >(text, text_length, sa);
+    return;
+  }
   std::uint64_t * const sa64 = new std::uint64_t[text_length];
   compute_sa(text, text_length, sa64);
   for (std::uint64_t i = 0; i < text_length; ++i)
@@ -108,15 +212,30 @@ void compute_sa(
 }
 
 //=============================================================================
-// Instantiation (not space efficient) of compute_sa for
-// text_offset_type == uint48 and char_type == std::uint8_t.
+// Instantiation of compute_sa for text_offset_type == uint48 and
+// char_type == std::uint8_t, see the uint40 instantiation. Texts of up
+// to 2^46 characters are sorted in place.
 //=============================================================================
 template<>
 void compute_sa(
     const std::uint8_t * const text,
     const std::uint64_t text_length,
-    uint48 * const sa) {
+    uint48 * const sa,
+    const std::uint64_t n_threads) {
 
+  if (text_length < (1UL << 31)) {
+    void * const buffer = sa;
+    compute_sa(text, text_length, (std::uint32_t *)buffer, n_threads);
+    widen_sa_in_place(sa, text_length);
+    return;
+  }
+  if (n_threads > 1 &&
+      parallel_compute_sa(text, text_length, sa, n_threads))
+    return;
+  if (text_length < (1UL << 46)) {
+    compute_sa_in_place<packed_int<std::int16_t> >(text, text_length, sa);
+    return;
+  }
   std::uint64_t * const sa64 = new std::uint64_t[text_length];
   compute_sa(text, text_length, sa64);
   for (std::uint64_t i = 0; i < text_length; ++i)
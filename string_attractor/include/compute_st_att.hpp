@@ -42,14 +42,672 @@
 #include "sais.hxx"
 #include "naive_compute_sa.hpp"
 #include "compute_lz77.hpp"
+#include "compute_attractor.hpp"
 #include "compute_sa.hpp"
 #include "utils.hpp"
 //#include "rmq.hpp"
 #include "rmq_tree.hpp"
+#include "rmq_sparse_table.hpp"
+#include "rmq_fischer_heun.hpp"
+#include "parallel_utils.hpp"
+#include "karp_rabin.hpp"
+#include "packed_array.hpp"
+#include "fast_divisor.hpp"
+#include "wavelet_matrix.hpp"
 #include <cstring>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <string>
 #include <map>
+#include <unordered_map>
 using namespace std;
 
+//=============================================================================
+// Header of the on-disk st_att index. It is followed by:
+//   b_si[levels]                 block length of every level (int64),
+//   level_size[levels - 1]       number of blocks of every non-leaf level,
+//   offset_bits[levels - 1]      width of the offset field of every level,
+//   pointers of every level      packed_array words of the level,
+//   window_base                  packed_array words, gamma entries of
+//                                window_bits bits (absent if levels == 1),
+//   leaves                       leaf_length characters.
+// A pointer is stored as (attractor << offset_bits[l]) | offset in
+// attractor_bits + offset_bits[l] bits. All other integers are 64-bit, so
+// every section is 8-byte aligned as long as the file is mapped at a page
+// boundary.
+//=============================================================================
+struct st_att_file_header
+{
+  static const std::uint64_t file_magic = 0x00005454415f5453ULL;
+  static const std::uint64_t file_version = 3;
+
+  std::uint64_t magic;
+  std::uint64_t version;
+  std::uint64_t text_length;
+  std::uint64_t tau;
+  std::uint64_t alpha;
+  std::uint64_t gamma;
+  std::uint64_t levels;
+  std::uint64_t leaf_length;
+  std::uint64_t attractor_bits;
+  std::uint64_t window_bits;
+};
+
+//=============================================================================
+// Everything a query needs to know about one level, so that the query loop
+// reads a single small table instead of several vectors. The position of a
+// query inside the window of its attractor, rel = off - attractor + window,
+// is never negative, so blocks are found with an unsigned fast_divisor.
+//=============================================================================
+struct st_att_level
+{
+  const std::uint64_t *words;    // packed pointers of the level
+  std::uint64_t width;           // attractor_bits + offset_bits
+  std::uint64_t offset_bits;
+  std::uint64_t offset_mask;
+  std::uint64_t block_len;
+  std::uint64_t window;          // tau * block_len
+  std::uint64_t window_blocks;   // 2 * tau
+  std::uint64_t block_shift;     // log2(block_len) if it is a power of two
+  fast_divisor divisor;          // divides by block_len
+};
+
+//=============================================================================
+// Return text[index] by walking the levels of an st_att index given by
+// its level table and leaves. The loop is not recursive and divides with
+// precomputed magic numbers only.
+//=============================================================================
+template <typename char_type>
+inline char_type st_att_access(const st_att_level *level, std::uint64_t last_level,
+                               const char_type *leaves, const std::uint64_t *window_base,
+                               std::uint64_t window_bits, std::uint64_t index)
+{
+  if (last_level == 0)
+    return leaves[index];
+  std::uint64_t block = level->divisor.divide(index);
+  std::uint64_t offset = index - block * level->block_len;
+  for (std::uint64_t l = 1;; l++, level++)
+  {
+    const std::uint64_t pointer = packed_array::get(level->words, level->width, block);
+    const std::uint64_t attractor = pointer >> level->offset_bits;
+    const std::uint64_t rel = offset - (pointer & level->offset_mask) + level[1].window;
+    if (l == last_level)
+      return leaves[packed_array::get(window_base, window_bits, attractor) + rel];
+    const std::uint64_t q = level[1].divisor.divide(rel);
+    offset = rel - q * level[1].block_len;
+    block = attractor * level[1].window_blocks + q;
+  }
+}
+
+//=============================================================================
+// Copy the len characters starting at offset rel of a window of the given
+// level, whose first block is first_block, to out (see st_att_extract).
+// The range is cut at block boundaries and every piece is followed to the
+// next level as a whole, where it spans at most two blocks. levels_below
+// is the number of levels down to the leaves.
+//=============================================================================
+template <typename char_type>
+void st_att_extract_window(const st_att_level *level, std::uint64_t levels_below,
+                           const char_type *leaves, const std::uint64_t *window_base,
+                           std::uint64_t window_bits, std::uint64_t first_block,
+                           std::uint64_t rel, std::uint64_t len, char_type *out)
+{
+  std::uint64_t block = level->divisor.divide(rel);
+  std::uint64_t offset = rel - block * level->block_len;
+  for (block += first_block; len > 0; block++, offset = 0)
+  {
+    const std::uint64_t piece = std::min(len, level->block_len - offset);
+    const std::uint64_t pointer = packed_array::get(level->words, level->width, block);
+    const std::uint64_t attractor = pointer >> level->offset_bits;
+    const std::uint64_t next_rel = offset - (pointer & level->offset_mask) + level[1].window;
+    if (levels_below == 1)
+    {
+      const char_type *src = leaves +
+          packed_array::get(window_base, window_bits, attractor) + next_rel;
+      std::copy(src, src + piece, out);
+    }
+    else
+      st_att_extract_window(level + 1, levels_below - 1, leaves, window_base,
+          window_bits, attractor * level[1].window_blocks, next_rel, piece, out);
+    out += piece;
+    len -= piece;
+  }
+}
+
+//=============================================================================
+// Copy text[start..start + len) to out by walking the levels of an st_att
+// index given by its level table and leaves, as st_att_access does for a
+// single character.
+//=============================================================================
+template <typename char_type>
+void st_att_extract(const st_att_level *level, std::uint64_t last_level,
+                    const char_type *leaves, const std::uint64_t *window_base,
+                    std::uint64_t window_bits, std::uint64_t start, std::uint64_t len,
+                    char_type *out)
+{
+  if (last_level == 0)
+    std::copy(leaves + start, leaves + start + len, out);
+  else if (len > 0)
+    st_att_extract_window(level, last_level, leaves, window_base, window_bits,
+        0, start, len, out);
+}
+
+//=============================================================================
+// Write the whole text[0..n) to out using n_threads threads. Chunks of
+// 1 MiB are handed out with work stealing and extracted with
+// st_att_extract into their own slice of out.
+//=============================================================================
+template <typename char_type>
+void st_att_decompress(const st_att_level *level, std::uint64_t last_level,
+                       const char_type *leaves, const std::uint64_t *window_base,
+                       std::uint64_t window_bits, std::uint64_t n, char_type *out,
+                       std::uint64_t n_threads)
+{
+  static const std::uint64_t chunk = 1UL << 20;
+  parallel_utils::work_stealing_for((n + chunk - 1) / chunk, n_threads, 1,
+      [&](std::uint64_t task, std::uint64_t)
+      {
+        const std::uint64_t beg = task * chunk;
+        st_att_extract(level, last_level, leaves, window_base, window_bits,
+            beg, std::min(chunk, n - beg), out + beg);
+      });
+}
+
+//=============================================================================
+// Answer out[i] = text[positions[i]] for a batch of count positions. The
+// batch is cut into chunks that move through the index one level at a time,
+// so the pointer reads of a level are independent of each other and are
+// prefetched a few queries ahead. If sort is set, the positions are sorted
+// first: the reads of a level then go through memory in increasing order,
+// and neighbouring queries that share a block or an attractor window share
+// its read. For random positions the sort costs more than it saves, even
+// with many queries per block, so it is off by default.
+//=============================================================================
+template <typename char_type, typename position_type>
+void st_att_access_batch(const st_att_level *level_table, std::uint64_t last_level,
+                         const char_type *leaves, const std::uint64_t *window_base,
+                         std::uint64_t window_bits, const position_type *positions,
+                         std::uint64_t count, char_type *out, bool sort)
+{
+  static const std::uint64_t chunk_size = 1024;
+  static const std::uint64_t prefetch_distance = 16;
+
+  // If sorted, queries are processed in the order of the keys
+  // (position << id_bits) | id, which are sorted by LSD radix sort with
+  // 11-bit digits. Otherwise they are processed in the given order.
+  std::uint64_t max_position = 0;
+  for (std::uint64_t i = 0; i < count; i++)
+    max_position = max(max_position, (std::uint64_t)positions[i]);
+  const std::uint64_t id_bits = packed_array::bits_for(count);
+  if (id_bits + packed_array::bits_for(max_position) > 64)
+    sort = false;
+  const std::uint64_t id_mask = (1UL << id_bits) - 1;
+  std::vector<std::uint64_t> keys;
+  if (sort)
+  {
+    static const std::uint64_t digit_bits = 11;
+    keys.resize(count);
+    for (std::uint64_t i = 0; i < count; i++)
+      keys[i] = ((std::uint64_t)positions[i] << id_bits) | i;
+    std::vector<std::uint64_t> temp(count);
+    std::vector<std::uint64_t> bucket(1UL << digit_bits);
+    for (std::uint64_t shift = id_bits;
+         shift < 64 && (max_position >> (shift - id_bits)) > 0; shift += digit_bits)
+    {
+      std::fill(bucket.begin(), bucket.end(), 0);
+      for (std::uint64_t i = 0; i < count; i++)
+        bucket[(keys[i] >> shift) & (bucket.size() - 1)]++;
+      for (std::uint64_t d = 0, sum = 0; d < bucket.size(); d++)
+      {
+        const std::uint64_t c = bucket[d];
+        bucket[d] = sum;
+        sum += c;
+      }
+      for (std::uint64_t i = 0; i < count; i++)
+        temp[bucket[(keys[i] >> shift) & (bucket.size() - 1)]++] = keys[i];
+      keys.swap(temp);
+    }
+  }
+
+  std::vector<std::uint64_t> id(chunk_size), block(chunk_size), offset(chunk_size);
+  for (std::uint64_t beg = 0; beg < count; beg += chunk_size)
+  {
+    const std::uint64_t m = min(chunk_size, count - beg);
+    const st_att_level *level = level_table;
+    for (std::uint64_t i = 0; i < m; i++)
+    {
+      std::uint64_t position;
+      if (sort)
+      {
+        position = keys[beg + i] >> id_bits;
+        id[i] = keys[beg + i] & id_mask;
+      }
+      else
+      {
+        position = positions[beg + i];
+        id[i] = beg + i;
+      }
+      if (last_level == 0)
+      {
+        offset[i] = position;
+        continue;
+      }
+      block[i] = level->divisor.divide(position);
+      offset[i] = position - block[i] * level->block_len;
+    }
+
+    // Follow the pointers. After the last step block[i] is the attractor
+    // and offset[i] the position in its window.
+    for (std::uint64_t l = 1; l <= last_level; l++, level++)
+    {
+      std::uint64_t prev_block = ~0UL, pointer = 0;
+      for (std::uint64_t i = 0; i < m; i++)
+      {
+        if (i + prefetch_distance < m)
+          __builtin_prefetch(level->words +
+              ((block[i + prefetch_distance] * level->width) >> 6));
+        if (block[i] != prev_block)
+        {
+          prev_block = block[i];
+          pointer = packed_array::get(level->words, level->width, block[i]);
+        }
+        const std::uint64_t attractor = pointer >> level->offset_bits;
+        const std::uint64_t rel = offset[i] - (pointer & level->offset_mask) +
+                                  level[1].window;
+        if (l == last_level)
+        {
+          block[i] = attractor;
+          offset[i] = rel;
+        }
+        else
+        {
+          const std::uint64_t q = level[1].divisor.divide(rel);
+          offset[i] = rel - q * level[1].block_len;
+          block[i] = attractor * level[1].window_blocks + q;
+        }
+      }
+    }
+
+    // Turn the window positions into leaf positions, then read the leaves.
+    std::uint64_t prev_attractor = ~0UL, base = 0;
+    for (std::uint64_t i = 0; i < m && last_level > 0; i++)
+    {
+      if (i + prefetch_distance < m)
+        __builtin_prefetch(window_base +
+            ((block[i + prefetch_distance] * window_bits) >> 6));
+      if (block[i] != prev_attractor)
+      {
+        prev_attractor = block[i];
+        base = packed_array::get(window_base, window_bits, block[i]);
+      }
+      offset[i] += base;
+    }
+    for (std::uint64_t i = 0; i < m; i++)
+    {
+      if (i + prefetch_distance < m)
+        __builtin_prefetch(leaves + offset[i + prefetch_distance]);
+      out[id[i]] = leaves[offset[i]];
+    }
+  }
+}
+
+//=============================================================================
+// Answer a stream of queries keeping group_size of them in flight. Every
+// query is a small state machine that makes one step of its walk at a time:
+// read the prefetched pointer of its level, prefetch the next one and give
+// way to the next query of the group. The cache misses of different
+// queries thus overlap, without sorting or even knowing the queries ahead.
+// source(position) returns false when there are no more queries;
+// sink(i, c) receives the answer c to the i-th query. Answers may arrive
+// out of order.
+//=============================================================================
+template <typename char_type, typename source_type, typename sink_type>
+void st_att_access_interleaved(const st_att_level *level_table, std::uint64_t last_level,
+                               const char_type *leaves, const std::uint64_t *window_base,
+                               std::uint64_t window_bits, source_type source,
+                               sink_type sink, std::uint64_t group_size)
+{
+  // A query at stage l < last_level reads a pointer of level l, at stage
+  // last_level the base of its window and at last_level + 1 its leaf.
+  struct query_state
+  {
+    std::uint64_t id;
+    std::uint64_t stage;
+    std::uint64_t block;
+    std::uint64_t offset;
+  };
+  std::vector<query_state> group(max(group_size, (std::uint64_t)1));
+  std::uint64_t active = 0, next_id = 0;
+  bool more = true;
+  std::uint64_t position;
+  while (more && active < group.size() && (more = source(position)))
+  {
+    query_state &q = group[active++];
+    q.id = next_id++;
+    if (last_level == 0)
+    {
+      q.stage = 1;
+      q.offset = position;
+      __builtin_prefetch(leaves + position);
+      continue;
+    }
+    q.stage = 0;
+    q.block = level_table->divisor.divide(position);
+    q.offset = position - q.block * level_table->block_len;
+    __builtin_prefetch(level_table->words + ((q.block * level_table->width) >> 6));
+  }
+
+  for (std::uint64_t i = 0; active > 0; i = (i + 1 < active) ? i + 1 : 0)
+  {
+    query_state &q = group[i];
+    if (q.stage < last_level)
+    {
+      const st_att_level * const level = level_table + q.stage;
+      const std::uint64_t pointer = packed_array::get(level->words, level->width, q.block);
+      const std::uint64_t attractor = pointer >> level->offset_bits;
+      const std::uint64_t rel = q.offset - (pointer & level->offset_mask) +
+                                level[1].window;
+      if (++q.stage == last_level)
+      {
+        q.block = attractor;
+        q.offset = rel;
+        __builtin_prefetch(window_base + ((attractor * window_bits) >> 6));
+      }
+      else
+      {
+        const std::uint64_t b = level[1].divisor.divide(rel);
+        q.offset = rel - b * level[1].block_len;
+        q.block = attractor * level[1].window_blocks + b;
+        __builtin_prefetch(level[1].words + ((q.block * level[1].width) >> 6));
+      }
+    }
+    else if (q.stage == last_level)
+    {
+      q.offset += packed_array::get(window_base, window_bits, q.block);
+      q.stage++;
+      __builtin_prefetch(leaves + q.offset);
+    }
+    else
+    {
+      sink(q.id, leaves[q.offset]);
+
+      // Replace the query by the next one of the stream, or retire it.
+      if (more && (more = source(position)))
+      {
+        q.id = next_id++;
+        if (last_level == 0)
+        {
+          q.offset = position;
+          __builtin_prefetch(leaves + position);
+          continue;
+        }
+        q.stage = 0;
+        q.block = level_table->divisor.divide(position);
+        q.offset = position - q.block * level_table->block_len;
+        __builtin_prefetch(level_table->words + ((q.block * level_table->width) >> 6));
+      }
+      else
+      {
+        q = group[--active];
+      }
+    }
+  }
+}
+
+//=============================================================================
+// st_att_access for an index whose tau is 2^log_tau and whose block lengths
+// are powers of two. Every division becomes a shift and every modulo a mask.
+//=============================================================================
+template <std::uint64_t log_tau, typename char_type>
+inline char_type st_att_access_pow2(const st_att_level *level, std::uint64_t last_level,
+                                    const char_type *leaves, const std::uint64_t *window_base,
+                                    std::uint64_t window_bits, std::uint64_t index)
+{
+  if (last_level == 0)
+    return leaves[index];
+  std::uint64_t block = index >> level->block_shift;
+  std::uint64_t offset = index & (level->block_len - 1);
+  for (std::uint64_t l = 1;; l++, level++)
+  {
+    const std::uint64_t pointer = packed_array::get(level->words, level->width, block);
+    const std::uint64_t attractor = pointer >> level->offset_bits;
+    const std::uint64_t shift = level[1].block_shift;
+    const std::uint64_t rel = offset - (pointer & level->offset_mask) +
+                              ((1UL << log_tau) << shift);
+    if (l == last_level)
+      return leaves[packed_array::get(window_base, window_bits, attractor) + rel];
+    block = (attractor << (log_tau + 1)) | (rel >> shift);
+    offset = rel & ((1UL << shift) - 1);
+  }
+}
+
+//=============================================================================
+// Bidirectional iterator over the text of an st_att index. It keeps the
+// path from level 0 to the leaves of the current position: for every level
+// the text range [beg, end) of the current block and where that range
+// starts on the next level. Within the range of the deepest block the
+// characters are consecutive in the leaves, at a fixed offset from their
+// text positions, so a step only moves the position.
+// Leaving that range re-descends from the deepest block that still covers
+// the position, which makes a step amortized O(1). If reverse is set, ++
+// moves left; such iterators serve as rbegin() and rend().
+//=============================================================================
+template <typename char_type, bool reverse = false>
+class st_att_iterator
+{
+public:
+  typedef std::bidirectional_iterator_tag iterator_category;
+  typedef char_type value_type;
+  typedef std::int64_t difference_type;
+  typedef const char_type *pointer;
+  typedef const char_type &reference;
+
+private:
+  // The block of a level and, for the next level, its attractor and the
+  // position in its window of text[beg].
+  struct path_entry
+  {
+    std::int64_t beg;
+    std::int64_t end;
+    std::uint64_t attractor;
+    std::uint64_t rel;
+  };
+
+  // Block lengths at least halve from level to level, so a text shorter
+  // than 2^63 has fewer levels.
+  static const std::uint64_t max_levels = 63;
+
+  const st_att_level *level_table;
+  std::uint64_t last_level;
+  const char_type *leaves;
+  const std::uint64_t *window_base;
+  std::uint64_t window_bits;
+  std::int64_t n;
+  std::int64_t pos;
+  std::int64_t run_beg;
+  std::int64_t run_end;
+  std::uint64_t run_offset;
+  std::uint64_t path_levels;
+  path_entry path[max_levels];
+
+  //Copy the members and the levels of the path in use
+  void copy(const st_att_iterator &other)
+  {
+    level_table = other.level_table;
+    last_level = other.last_level;
+    leaves = other.leaves;
+    window_base = other.window_base;
+    window_bits = other.window_bits;
+    n = other.n;
+    pos = other.pos;
+    run_beg = other.run_beg;
+    run_end = other.run_end;
+    run_offset = other.run_offset;
+    path_levels = other.path_levels;
+    std::copy(other.path, other.path + path_levels, path);
+  }
+
+  //Rebuild the path below level l for pos, whose block on level l - 1
+  //is already on the path
+  void descend(std::uint64_t l)
+  {
+    for (; l < last_level; l++)
+    {
+      const st_att_level &lv = level_table[l];
+      std::uint64_t block, offset;
+      std::int64_t parent_beg = 0, parent_end = n;
+      if (l == 0)
+      {
+        block = lv.divisor.divide(pos);
+        offset = pos - block * lv.block_len;
+      }
+      else
+      {
+        const path_entry &parent = path[l - 1];
+        const std::uint64_t rel = parent.rel + (pos - parent.beg);
+        const std::uint64_t q = lv.divisor.divide(rel);
+        offset = rel - q * lv.block_len;
+        block = parent.attractor * lv.window_blocks + q;
+        parent_beg = parent.beg;
+        parent_end = parent.end;
+      }
+      path_entry &e = path[l];
+      e.beg = max(pos - (std::int64_t)offset, parent_beg);
+      e.end = min(pos - (std::int64_t)offset + (std::int64_t)lv.block_len, parent_end);
+      const std::uint64_t p = packed_array::get(lv.words, lv.width, block);
+      e.attractor = p >> lv.offset_bits;
+      e.rel = offset - (pos - e.beg) - (p & lv.offset_mask) + level_table[l + 1].window;
+    }
+    if (last_level == 0)
+    {
+      run_beg = 0;
+      run_end = n;
+      run_offset = 0;
+      return;
+    }
+    const path_entry &e = path[last_level - 1];
+    run_beg = e.beg;
+    run_end = e.end;
+    run_offset = packed_array::get(window_base, window_bits, e.attractor) +
+                 e.rel - e.beg;
+  }
+
+  //Find the leaf of pos after it left the current run. The path is
+  //filled on the first step into the text, so end() and rend() are
+  //cheap to construct.
+  void seek()
+  {
+    if (pos < 0 || pos >= n)
+      return;
+    if (path_levels < last_level)
+    {
+      path_levels = last_level;
+      descend(0);
+      return;
+    }
+    std::uint64_t l = last_level;
+    while (l > 0 && (pos < path[l - 1].beg || pos >= path[l - 1].end))
+      l--;
+    descend(l);
+  }
+
+  inline void forward()
+  {
+    ++pos;
+    if ((std::uint64_t)(pos - run_beg) >= (std::uint64_t)(run_end - run_beg))
+      seek();
+  }
+
+  inline void backward()
+  {
+    --pos;
+    if ((std::uint64_t)(pos - run_beg) >= (std::uint64_t)(run_end - run_beg))
+      seek();
+  }
+
+public:
+  st_att_iterator()
+      : level_table(NULL), last_level(0), leaves(NULL), window_base(NULL),
+        window_bits(0), n(0), pos(0), run_beg(0), run_end(0), run_offset(0),
+        path_levels(0) {}
+
+  st_att_iterator(const st_att_level *m_level_table, std::uint64_t m_last_level,
+                  const char_type *m_leaves, const std::uint64_t *m_window_base,
+                  std::uint64_t m_window_bits, std::int64_t m_n, std::int64_t m_pos)
+      : level_table(m_level_table), last_level(m_last_level), leaves(m_leaves),
+        window_base(m_window_base), window_bits(m_window_bits), n(m_n),
+        pos(m_pos), run_beg(0), run_end(0), run_offset(0), path_levels(0)
+  {
+    seek();
+  }
+
+  st_att_iterator(const st_att_iterator &other)
+  {
+    copy(other);
+  }
+
+  st_att_iterator &operator=(const st_att_iterator &other)
+  {
+    copy(other);
+    return *this;
+  }
+
+  inline reference operator*() const
+  {
+    return leaves[run_offset + pos];
+  }
+
+  inline st_att_iterator &operator++()
+  {
+    if (reverse)
+      backward();
+    else
+      forward();
+    return *this;
+  }
+
+  inline st_att_iterator operator++(int)
+  {
+    st_att_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  inline st_att_iterator &operator--()
+  {
+    if (reverse)
+      forward();
+    else
+      backward();
+    return *this;
+  }
+
+  inline st_att_iterator operator--(int)
+  {
+    st_att_iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  inline bool operator==(const st_att_iterator &other) const
+  {
+    return pos == other.pos;
+  }
+
+  inline bool operator!=(const st_att_iterator &other) const
+  {
+    return pos != other.pos;
+  }
+
+  //Text position of the iterator
+  inline std::int64_t position() const
+  {
+    return pos;
+  }
+};
+
 template <
     typename char_type = std::uint8_t,
     typename text_offset_type = std::int64_t>
@@ -67,6 +725,94 @@ struct Block
   }
 };
 
+//=============================================================================
+// Suffix array of the text together with its inverse, the LCP array
+// (lcp[i] = lcp of suffixes sa[i - 1] and sa[i]) and RMQ over sa and lcp.
+// The SA interval of a block is found by expanding around isa[start]
+// while the LCP stays at least the block length, so finding it takes
+// no character comparisons. The RMQ is any type with the interface of
+// rmq_tree, e.g., rmq_sparse_table or rmq_fischer_heun. For an attractor
+// other than the LZ77 phrase ends, use_attractor adds the distance from
+// every suffix to the next attractor with RMQ over it, which finds an
+// occurrence of a block containing an attractor.
+//=============================================================================
+template <
+    typename char_type = std::uint8_t,
+    typename sa_offset_type = std::uint64_t,
+    typename rmq_type = rmq_tree<sa_offset_type> >
+struct sa_index
+{
+  sa_offset_type *sa;
+  sa_offset_type *isa;
+  sa_offset_type *lcp;
+  rmq_type *sa_rmq;
+  rmq_type *lcp_rmq;
+  sa_offset_type *dist;
+  rmq_type *dist_rmq;
+
+  sa_index(const char_type *text, std::uint64_t n, std::uint64_t n_threads)
+    : dist(NULL), dist_rmq(NULL)
+  {
+    // Compute SA and ISA.
+    sa = new sa_offset_type[n];
+    isa = new sa_offset_type[n];
+    compute_sa(text, n, sa, n_threads);
+    parallel_utils::parallel_for(0, n, n_threads,
+        [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+          for (std::uint64_t i = beg; i < end; ++i)
+            isa[sa[i]] = i;
+        });
+
+    // Compute LCP using the algorithm of Kasai et al.
+    lcp = new sa_offset_type[n];
+    std::uint64_t h = 0;
+    for (std::uint64_t i = 0; i < n; ++i)
+    {
+      const std::uint64_t rank = isa[i];
+      if (rank == 0)
+      {
+        lcp[0] = 0;
+        h = 0;
+        continue;
+      }
+      const std::uint64_t j = sa[rank - 1];
+      while (i + h < n && j + h < n && text[i + h] == text[j + h])
+        ++h;
+      lcp[rank] = h;
+      if (h > 0)
+        --h;
+    }
+    sa_rmq = new rmq_type(sa, n);
+    lcp_rmq = new rmq_type(lcp, n);
+  }
+
+  //Compute dist[i], the distance from sa[i] to the next of the sorted
+  //attractor positions (or n - sa[i] if there is none)
+  template <typename text_offset_type>
+  void use_attractor(const std::vector<text_offset_type> &att_pos, std::uint64_t n)
+  {
+    dist = new sa_offset_type[n];
+    for (std::uint64_t x = n, next = n, k = att_pos.size(); x > 0; --x)
+    {
+      if (k > 0 && (std::uint64_t)att_pos[k - 1] == x - 1)
+        next = att_pos[--k];
+      dist[isa[x - 1]] = next - (x - 1);
+    }
+    dist_rmq = new rmq_type(dist, n);
+  }
+
+  ~sa_index()
+  {
+    delete dist_rmq;
+    delete[] dist;
+    delete sa_rmq;
+    delete lcp_rmq;
+    delete[] sa;
+    delete[] isa;
+    delete[] lcp;
+  }
+};
+
 template <
     typename char_type = std::uint8_t,
     typename text_offset_type = std::int64_t,
@@ -76,13 +822,18 @@ struct linked_indexes
   typedef std::pair<text_offset_type, text_offset_type> pair_type;
   pair_type p;
 
+  linked_indexes(text_offset_type attractor_loc_, text_offset_type offset)
+  {
+    p = std::make_pair(attractor_loc_, offset);
+  }
+
+  template <typename index_type>
   linked_indexes(char_type *text, text_offset_type start,
                  text_offset_type end, std::vector<text_offset_type> &att_pos,
-                 text_offset_type len, rmq_tree<sa_offset_type> *sa_rmq,
-                 sa_offset_type * const sa)
+                 text_offset_type len, const index_type &index)
   {
     text_offset_type attractor_loc_, offset;
-    find(text, start, end, att_pos, &attractor_loc_, &offset, len,sa_rmq,sa);
+    find(text, start, end, att_pos, &attractor_loc_, &offset, len, index);
     p = std::make_pair<text_offset_type, text_offset_type>((long int)attractor_loc_,
                                                            (long int)offset);
   }
@@ -92,230 +843,1485 @@ struct linked_indexes
     return p.first - p.second;
   }
 
-  static void find(char_type *text, text_offset_type start, text_offset_type end,
+  template <typename index_type>
+  static void find(char_type *, text_offset_type start, text_offset_type end,
                    std::vector<text_offset_type> &att_pos, text_offset_type *attractor_loc_,
-                   text_offset_type *offset, text_offset_type len, rmq_tree<sa_offset_type> *sa_rmq,
-                   sa_offset_type * const sa)
+                   text_offset_type *offset, text_offset_type len,
+                   const index_type &index)
   {
     *attractor_loc_ = -1;
     *offset = -1;
-    end = min(len-1,end);
-    if (end  < 0 || start >=len)
+    end = min(len, end);
+    if (end <= 0 || start >= end)
       return;
-    text_offset_type low=0, hi = len-1,r1,r2,mid,temp_st;
-    while(low < hi)
-    {
-      mid = (low+hi)/2;
-      temp_st = sa[mid];
-      text_offset_type j = start;
-      for(; j <=end;j++)
-      {
-        if((temp_st+j-start) == len || text[temp_st + j - start] < text[j])
-        {
-          low = mid + 1;
-          break;
-        }
-        else if(text[temp_st + j - start] > text[j]){
-          hi = mid - 1;
-          break;
-        }
-      }
-      if(j==(end+1))
-        hi = mid;
-    }
 
-    r1 = low;
-    low = 0;
-    hi = len - 1;
-    while(low < hi)
+    // Take the leftmost occurrence of text[start..end), which contains an
+    // LZ77 phrase end, or for other attractors the one closest to its next
+    // attractor.
+    const std::uint64_t m = end - start;
+    std::uint64_t r1, r2;
+    compute_attractor::sa_interval(index.isa, *index.lcp_rmq, len, start, m, r1, r2);
+    text_offset_type x;
+    if (index.dist_rmq == NULL)
+      x = index.sa[index.sa_rmq->rmq(r1, r2 + 1)];
+    else
     {
-      mid = (low+hi+1)/2;
-      temp_st = sa[mid];
-      text_offset_type j = start;
-      for(; j <=end;j++)
+      const std::uint64_t r = index.dist_rmq->rmq(r1, r2 + 1);
+      if ((std::uint64_t)index.dist[r] >= m)
       {
-        if((temp_st+j-start) == len || text[temp_st + j - start] < text[j]){
-          low = mid + 1;
-          break;
-        }
-        else if(text[temp_st + j - start] > text[j]){
-          hi = mid - 1;
-          break;
-        }
+        fprintf(stderr, "\nError: the positions are not an attractor\n");
+        std::exit(EXIT_FAILURE);
       }
-      if(j==(end+1))
-        low = mid;
-    }
-    r2 = hi;
-    text_offset_type x = sa[sa_rmq->rmq(r1,r2+1)];
-    low = 0;
-    hi = att_pos.size() - 1;
-    while(low < hi){
-      mid = (low+hi)/2;
-      if(att_pos[mid] < x)
-        low = mid + 1;
+      x = index.sa[r];
+    }
+    text_offset_type low = 0, high = att_pos.size() - 1, middle;
+    while(low < high){
+      middle = (low+high)/2;
+      if(att_pos[middle] < x)
+        low = middle + 1;
       else
-        hi = mid;
+        high = middle;
     }
     *attractor_loc_ = low;
     *offset = att_pos[low] - x;
-    return;
-    
-
-    //This is very slow !! need to implement RMQ with binary search later on toop of it
   }
 };
 
+//=============================================================================
+// Resolve the blocks of all given levels. Blocks are independent of each
+// other, so they are spread over n_threads threads with work stealing.
+//=============================================================================
 template <
     typename char_type = std::uint8_t,
     typename text_offset_type = std::int64_t,
-    typename sa_offset_type = std::uint64_t>
-std::vector<linked_indexes<> *> make_linked_indexes(char_type *text, std::vector<Block<>> &b,
+    typename index_type>
+std::vector<std::vector<linked_indexes<> *> > make_linked_indexes(char_type *text,
+                                                  std::vector<std::vector<Block<> > > &levels,
                                                   std::vector<text_offset_type> &att_pos, text_offset_type len,
-                                                  rmq_tree<sa_offset_type> *sa_rmq,
-                                                  sa_offset_type * const sa)
+                                                  const index_type &index,
+                                                  std::uint64_t n_threads = 1)
 {
-  std::vector<linked_indexes<>*> v;
-  for (text_offset_type i = 0; i < (text_offset_type)b.size(); i++)
-    v.push_back((new linked_indexes<>(text, max((int64_t)0, b[i].start), b[i].end, att_pos, len,sa_rmq,sa)));
+  std::vector<std::vector<linked_indexes<> *> > v(levels.size());
+  std::vector<std::uint64_t> level_beg(1, 0);
+  for (std::uint64_t l = 0; l < levels.size(); l++)
+  {
+    v[l].resize(levels[l].size());
+    level_beg.push_back(level_beg.back() + levels[l].size());
+  }
+  parallel_utils::work_stealing_for(level_beg.back(), n_threads, 256,
+      [&](std::uint64_t task, std::uint64_t)
+      {
+        const std::uint64_t l = std::upper_bound(level_beg.begin(),
+            level_beg.end(), task) - level_beg.begin() - 1;
+        const Block<> &b = levels[l][task - level_beg[l]];
+        if (b.start < 0 && b.end > 0)
+          // A block sticking out of the text start is mapped onto itself.
+          // Its clipped part occurs at 0 and crosses attractor 0.
+          v[l][task - level_beg[l]] = new linked_indexes<>(0, att_pos[0] - b.start);
+        else if (b.start < 0)
+          // Blocks entirely before the text are never queried.
+          v[l][task - level_beg[l]] = new linked_indexes<>(-1, -1);
+        else
+          v[l][task - level_beg[l]] = new linked_indexes<>(text,
+              b.start, b.end, att_pos, len, index);
+      });
   return v;
 }
 
+//=============================================================================
+// Resolve the blocks of one level without a suffix array. Every block is
+// mapped to its leftmost occurrence, which contains an LZ77 phrase end.
+// Leftmost occurrences are found by sliding a Karp-Rabin fingerprint of
+// the block length over the text and looking it up among the fingerprints
+// of the still unresolved blocks. Blocks clipped at the text end have other
+// lengths and get a scan of their own. A scan stops as soon as all its
+// blocks are resolved, which on repetitive text is usually early.
+//=============================================================================
+template <
+    typename char_type = std::uint8_t,
+    typename text_offset_type = std::int64_t>
+void resolve_level_kr(const char_type *text, const std::vector<Block<> > &blocks,
+                      const std::vector<text_offset_type> &att_pos, text_offset_type len,
+                      std::uint64_t base, std::vector<linked_indexes<> *> &v)
+{
+  v.resize(blocks.size());
+  const auto resolve = [&](std::uint64_t i, text_offset_type x)
+  {
+    const text_offset_type a = std::lower_bound(att_pos.begin(),
+        att_pos.end(), x) - att_pos.begin();
+    v[i] = new linked_indexes<>(a, att_pos[a] - x);
+  };
+
+  // Group the blocks by the length of their part inside the text. As in
+  // the SA engine, a block straddling the text start is mapped onto itself
+  // and one entirely outside the text gets no pointer.
+  std::map<text_offset_type, std::vector<std::uint64_t> > by_length;
+  for (std::uint64_t i = 0; i < blocks.size(); i++)
+  {
+    const text_offset_type beg = max((text_offset_type)0, blocks[i].start);
+    const text_offset_type end = min(len, blocks[i].end);
+    if (beg >= end)
+      v[i] = new linked_indexes<>(-1, -1);
+    else if (blocks[i].start < 0)
+      resolve(i, blocks[i].start);
+    else
+      by_length[end - beg].push_back(i);
+  }
+
+  for (typename std::map<text_offset_type, std::vector<std::uint64_t> >::iterator
+           it = by_length.begin(); it != by_length.end(); ++it)
+  {
+    const text_offset_type m = it->first;
+    const std::vector<std::uint64_t> &ids = it->second;
+
+    // Hash the blocks. The bit filter on the low bits of the fingerprint
+    // avoids a hash table lookup at almost every text position.
+    std::uint64_t filter_bits = 64;
+    while (filter_bits < 16 * ids.size())
+      filter_bits <<= 1;
+    std::vector<std::uint64_t> filter(filter_bits / 64, 0);
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t> > table;
+    for (std::uint64_t j = 0; j < ids.size(); j++)
+    {
+      const std::uint64_t h = karp_rabin::fingerprint(
+          text + blocks[ids[j]].start, m, base);
+      filter[(h & (filter_bits - 1)) / 64] |= 1UL << (h % 64);
+      table[h].push_back(ids[j]);
+    }
+
+    // Slide the window until all blocks are resolved.
+    std::uint64_t pending = ids.size();
+    karp_rabin::rolling_hash<char_type> window(text, m, base);
+    for (text_offset_type x = 0; pending > 0; x++)
+    {
+      const std::uint64_t h = window.hash;
+      if (filter[(h & (filter_bits - 1)) / 64] & (1UL << (h % 64)))
+      {
+        typename std::unordered_map<std::uint64_t, std::vector<std::uint64_t> >::iterator
+            bucket = table.find(h);
+        if (bucket != table.end())
+        {
+          std::vector<std::uint64_t> &cand = bucket->second;
+          for (std::uint64_t j = 0; j < cand.size();)
+          {
+            if (std::equal(text + x, text + x + m, text + blocks[cand[j]].start))
+            {
+              resolve(cand[j], x);
+              cand[j] = cand.back();
+              cand.pop_back();
+              pending--;
+            }
+            else
+              j++;
+          }
+        }
+      }
+      if (x + m < len)
+        window.roll();
+    }
+  }
+}
+
+//=============================================================================
+// The string attractor index. The rmq_type is used on the suffix and LCP
+// arrays during construction only: rmq_tree (the default, n bits, scans
+// up to a few blocks per query), rmq_fischer_heun (O(1) time, ~10 bits per
+// item) or rmq_sparse_table (O(1) time, 4n log n bytes). All query members
+// are const and only read the index, so a constructed index can be queried
+// from any number of threads at once.
+//=============================================================================
 template <
     typename char_type = std::uint8_t,
     typename text_offset_type = std::int64_t,
-    typename sa_offset_type = std::uint64_t>
+    typename sa_offset_type = std::uint64_t,
+    typename rmq_type = rmq_tree<sa_offset_type> >
 class st_att
 {
-private:
+public:
+  typedef std::pair<sa_offset_type, sa_offset_type> pair_type;
+
+protected:
   text_offset_type tau;
   text_offset_type gamma;
   text_offset_type alpha;
   text_offset_type n;
   std::vector<text_offset_type> att_pos;
   std::vector<text_offset_type> b_si;
-  std::vector<std::vector<linked_indexes<> *>> indexes;
-  std::vector<char_type *> v_s;
+  std::uint64_t attractor_bits;
+  std::vector<std::uint64_t> offset_bits;
+  std::vector<packed_array> indexes;
+  std::uint64_t leaf_length;
+  char_type *leaves;
+  packed_array window_base;
+  std::vector<st_att_level> level_table;
   char_type *t;
-  //rmq<> *sa_rmq;
-  rmq_tree<sa_offset_type> *sa_rmq;
+  bool pow2_blocks;
+  // Karp-Rabin fingerprints, see make_fingerprints.
+  std::vector<std::vector<std::uint64_t> > block_fingerprints;
+  std::uint64_t fingerprint_base;
+  std::uint64_t text_fingerprint;
+  karp_rabin::power_table powers;
+  // Occurrence counts of one character, see make_char_counts.
+  struct char_counts
+  {
+    char_type c;
+    std::uint64_t total;                // occurrences in the text
+    std::vector<packed_array> block_rank;   // rank of every block start
+    std::vector<packed_array> source_rank;  // rank of every block source
+    std::vector<std::uint64_t> leaf_bits;  // occurrences in the leaves
+  };
+  std::vector<char_counts> counts;
+  // Pattern search, see make_search_index.
+  std::vector<text_offset_type> phrase_src;   // LZ77 source, -1 for literals
+  packed_array left_order;                    // attractors by reversed phrase
+  packed_array right_order;                   // attractors by suffix
+  wavelet_matrix grid;                        // right rank in left order
+  std::vector<text_offset_type> source_beg;   // sorted phrase sources
+  std::vector<std::uint64_t> source_phrase;
+  std::vector<sa_offset_type> source_key;     // n - source end
+  rmq_type *source_rmq;
 
-public:
-  st_att(text_offset_type m_tau, char_type *text, text_offset_type text_length)
+  //Text position of block i of the given level, which may lie outside
+  //the text for the blocks of windows close to the text ends
+  text_offset_type block_start(std::uint64_t level, std::uint64_t i) const
   {
-    typedef std::pair<sa_offset_type, sa_offset_type> pair_type;
-    n = text_length;
-    text_offset_type block_len;
-    tau = m_tau;
-    std::vector<Block<>> v;
-    t = text;
-    // Allocate SA.
-    sa_offset_type *const sa = new sa_offset_type[n];
-    // Compute SA.
+    if (level == 0)
+      return (text_offset_type)i * b_si[0];
+    return att_pos[i / (2 * tau)] - tau * b_si[level] +
+           (text_offset_type)(i % (2 * tau)) * b_si[level];
+  }
+
+  //Number of set bits in [beg, end) of the bit vector
+  static std::uint64_t count_bits(const std::uint64_t *bits, std::uint64_t beg,
+                                  std::uint64_t end)
+  {
+    std::uint64_t result = 0;
+    while (beg < end)
     {
-      compute_sa(text, (uint64_t)n, sa);
-      sa_rmq = new rmq_tree<sa_offset_type>(sa,n);
+      const std::uint64_t len = min(end - beg, 64 - (beg & 63));
+      const std::uint64_t word = bits[beg >> 6] >> (beg & 63);
+      result += __builtin_popcountll(len == 64 ? word : word & ((1UL << len) - 1));
+      beg += len;
     }
-    // Compute parsing.
-    std::vector<pair_type> parsing;
-       compute_lz77::kkp2n(text, text_length, sa, parsing);
-  
+    return result;
+  }
+
+  //Position of the k-th (from 0) set bit at or after beg
+  static std::uint64_t select_bit(const std::uint64_t *bits, std::uint64_t beg,
+                                  std::uint64_t k)
+  {
+    std::uint64_t word = bits[beg >> 6] >> (beg & 63) << (beg & 63);
+    std::uint64_t i = beg >> 6;
+    for (std::uint64_t ones; (ones = __builtin_popcountll(word)) <= k;
+         word = bits[++i])
+      k -= ones;
+    for (; k > 0; k--)
+      word &= word - 1;
+    return (i << 6) + __builtin_ctzll(word);
+  }
+
+  const char_counts &counts_of(char_type c) const
+  {
+    for (std::uint64_t i = 0; i < counts.size(); i++)
+      if (counts[i].c == c)
+        return counts[i];
+    fprintf(stderr, "\nError: no counts were made for the character\n");
+    std::exit(EXIT_FAILURE);
+  }
+
+  //Take the attractor positions from the LZ77 phrase ends
+  void make_attractors(const std::vector<pair_type> &parsing)
+  {
     std::uint64_t ind = -1;
     for (uint32_t i = 0; i < parsing.size(); i++)
     {
-      ind += parsing[i].second ? parsing[i].second : 1;
+      ind += std::max((std::uint64_t)parsing[i].second, (std::uint64_t)1);
       att_pos.push_back(ind);
+      phrase_src.push_back((std::uint64_t)parsing[i].second ?
+          (text_offset_type)(std::uint64_t)parsing[i].first : -1);
     }
     gamma = att_pos.size();
-    
-    //Make level 0 and assign alpha
-    block_len = n / gamma + (n % gamma != 0);
-    for (text_offset_type i = 0; i < n; i += block_len)
-      v.push_back(Block<>(i, block_len));
+    attractor_bits = packed_array::bits_for(gamma - 1);
+  }
+
+  //Take the attractor positions from a provider other than LZ77
+  void make_attractors(const std::vector<text_offset_type> &positions)
+  {
+    att_pos = positions;
+    phrase_src.clear();
+    gamma = att_pos.size();
+    attractor_bits = packed_array::bits_for(gamma - 1);
+  }
+
+  //Compute the block lengths of all levels and alpha. Returns the number
+  //of levels except the last, whose text is stored by make_leaves. A level
+  //is the last if its blocks are shorter than 2 * alpha. With pow2_blocks
+  //the level 0 block length is rounded down to a power of two; if tau is
+  //one too, so are all block lengths.
+  std::uint64_t make_block_lengths()
+  {
+    text_offset_type block_len = n / gamma + (n % gamma != 0);
+    if (pow2_blocks)
+    {
+      text_offset_type p = 1;
+      while (2 * p <= block_len)
+        p <<= 1;
+      block_len = p;
+    }
     b_si.push_back(block_len);
-    indexes.push_back(make_linked_indexes<>(text, v, att_pos, n,sa_rmq,sa));
     alpha = max((int)ceil(log(block_len) / log(tau)), 1);
-    //Now make all other levels
     while (block_len >= 2 * alpha)
     {
       block_len = block_len / tau + (block_len % tau != 0);
       b_si.push_back(block_len);
-      v.clear();
-      for (text_offset_type i = 0; i < (int64_t)att_pos.size(); i++)
+    }
+    return b_si.size() - 1;
+  }
+
+  //Lay out the blocks of a level: level 0 tiles the text, every other
+  //level has 2 * tau blocks around each attractor
+  std::vector<Block<> > make_level(std::uint64_t level) const
+  {
+    std::vector<Block<> > blocks;
+    const text_offset_type block_len = b_si[level];
+    if (level == 0)
+    {
+      for (text_offset_type i = 0; i < n; i += block_len)
+        blocks.push_back(Block<>(i, block_len));
+      return blocks;
+    }
+    blocks.reserve(2 * tau * att_pos.size());
+    for (text_offset_type i = 0; i < (int64_t)att_pos.size(); i++)
+    {
+      text_offset_type begin = att_pos[i] - tau * block_len;
+      text_offset_type end = att_pos[i] + tau * block_len;
+      for (text_offset_type j = begin; j < end; j += block_len)
+        blocks.push_back(Block<>(j, block_len));
+    }
+    return blocks;
+  }
+
+  //Lay out the blocks of all levels except the last
+  std::vector<std::vector<Block<> > > make_levels()
+  {
+    std::vector<std::vector<Block<> > > levels(make_block_lengths());
+    for (std::uint64_t l = 0; l < levels.size(); l++)
+      levels[l] = make_level(l);
+    return levels;
+  }
+
+  //Store the pointers of a level as (attractor, offset) packed into
+  //attractor_bits + offset_bits[level] bits and free the resolved blocks
+  void pack_level(std::uint64_t level, std::vector<linked_indexes<> *> &v)
+  {
+    // Blocks outside the text are never queried, they are stored as 0.
+    std::uint64_t max_offset = 0;
+    for (std::uint64_t i = 0; i < v.size(); i++)
+      if (v[i]->p.first >= 0)
+        max_offset = max(max_offset, (std::uint64_t)v[i]->p.second);
+    offset_bits[level] = packed_array::bits_for(max_offset);
+    indexes[level] = packed_array(v.size(), attractor_bits + offset_bits[level]);
+    for (std::uint64_t i = 0; i < v.size(); i++)
+    {
+      if (v[i]->p.first >= 0)
+        indexes[level].set(i, ((std::uint64_t)v[i]->p.first << offset_bits[level]) |
+                                  (std::uint64_t)v[i]->p.second);
+      delete v[i];
+    }
+    std::vector<linked_indexes<> *>().swap(v);
+  }
+
+  //Copy the text of the last level. Its blocks around attractor i cover
+  //the window [att_pos[i] - tau * bl, att_pos[i] + tau * bl). Windows of
+  //close attractors overlap, so only the union of the windows is stored
+  //and window_base[i] is the position of the window of attractor i in it.
+  //If level 0 is the last level, the leaves are just the padded text.
+  void make_leaves(const char_type *text, std::uint64_t n_threads)
+  {
+    const text_offset_type block_len = b_si.back();
+    const text_offset_type w = tau * block_len;
+
+    // Merge the windows into segments (text start, text end, buffer start).
+    std::vector<std::pair<text_offset_type, text_offset_type> > segments;
+    std::vector<std::uint64_t> segment_base;
+    std::vector<std::uint64_t> base;
+    if (b_si.size() == 1)
+    {
+      segments.push_back(std::make_pair((text_offset_type)0,
+          (n + block_len - 1) / block_len * block_len));
+      segment_base.push_back(0);
+    }
+    else
+    {
+      base.resize(att_pos.size());
+      for (std::uint64_t i = 0; i < att_pos.size(); i++)
       {
-        text_offset_type begin = att_pos[i] - tau * block_len;
-        text_offset_type end = att_pos[i] + tau * block_len;
-        for (text_offset_type j = begin; j < end; j += block_len){
-          v.push_back(Block<>(j, block_len));
+        const text_offset_type begin = att_pos[i] - w;
+        if (segments.empty() || begin >= segments.back().second)
+        {
+          segment_base.push_back(segments.empty() ? 0 :
+              segment_base.back() + segments.back().second - segments.back().first);
+          segments.push_back(std::make_pair(begin, begin));
         }
+        segments.back().second = att_pos[i] + w;
+        base[i] = segment_base.back() + (begin - segments.back().first);
       }
-      if (block_len >= 2 * alpha)
-        indexes.push_back(std::move(make_linked_indexes<>(text, v, att_pos, n,sa_rmq,sa)));
+    }
+    leaf_length = segment_base.back() + segments.back().second - segments.back().first;
+    window_base = packed_array(base.size(), packed_array::bits_for(leaf_length));
+    for (std::uint64_t i = 0; i < base.size(); i++)
+      window_base.set(i, base[i]);
+
+    leaves = utils::aligned_allocate_array<char_type>(leaf_length, 64);
+    parallel_utils::parallel_for(0, segments.size(), n_threads,
+        [&](std::uint64_t beg, std::uint64_t end, std::uint64_t)
+        {
+          for (std::uint64_t i = beg; i < end; i++)
+          {
+            char_type * const s = leaves + segment_base[i];
+            for (text_offset_type j = segments[i].first; j < segments[i].second; j++)
+            {
+              if (j >= 0 && j < n)
+                s[j - segments[i].first] = text[j];
+              else
+                s[j - segments[i].first] = '$';
+            }
+          }
+        });
+  }
+
+  //Fill the level table used by queries
+  void make_level_table()
+  {
+    level_table.resize(b_si.size());
+    for (std::uint64_t l = 0; l < b_si.size(); l++)
+    {
+      st_att_level &lv = level_table[l];
+      lv.block_len = b_si[l];
+      lv.window = (l == 0) ? 0 : tau * b_si[l];
+      lv.window_blocks = 2 * tau;
+      lv.block_shift = packed_array::bits_for(b_si[l]) - 1;
+      if (l + 1 == b_si.size())
+        continue;
+      lv.words = indexes[l].words();
+      lv.width = indexes[l].width();
+      lv.offset_bits = offset_bits[l];
+      lv.offset_mask = (1UL << offset_bits[l]) - 1;
+      lv.divisor = fast_divisor(b_si[l]);
+    }
+  }
+
+public:
+  //Construct the index, computing the suffix array and the attractor of
+  //the given provider, by default the ends of the LZ77 phrases (see
+  //compute_attractor). If m_pow2_blocks is set, block lengths are rounded
+  //down to powers of two (see st_att_pow2).
+  st_att(text_offset_type m_tau, char_type *text, text_offset_type text_length,
+         std::uint64_t n_threads = 1, bool m_pow2_blocks = false,
+         compute_attractor::attractor_type attractor = compute_attractor::lz77)
+  {
+    n = text_length;
+    tau = m_tau;
+    source_rmq = NULL;
+    t = text;
+    pow2_blocks = m_pow2_blocks;
+    // Compute SA, ISA and LCP.
+    sa_index<char_type, sa_offset_type, rmq_type> *index =
+        new sa_index<char_type, sa_offset_type, rmq_type>(text, n, n_threads);
+    // Compute the attractor.
+    if (attractor == compute_attractor::lz77)
+    {
+      std::vector<pair_type> parsing;
+      if (n_threads > 1)
+        compute_lz77::parallel_kkp2n(text, text_length, index->sa, parsing,
+            n_threads);
+      else
+        compute_lz77::kkp2n(text, text_length, index->sa, parsing);
+      make_attractors(parsing);
+    }
+    else
+    {
+      std::vector<text_offset_type> positions;
+      compute_attractor::compute(attractor, text, n, index->sa, index->isa,
+          index->lcp, *index->lcp_rmq, positions);
+      make_attractors(positions);
+      index->use_attractor(att_pos, n);
+    }
+    std::vector<std::vector<Block<> > > levels = make_levels();
+    std::vector<std::vector<linked_indexes<> *> > pointers =
+        make_linked_indexes<>(text, levels, att_pos, n, *index, n_threads);
+    levels.clear();
+    indexes.resize(pointers.size());
+    offset_bits.resize(pointers.size());
+    for (std::uint64_t l = 0; l < pointers.size(); l++)
+      pack_level(l, pointers[l]);
+    make_leaves(text, n_threads);
+    make_level_table();
+    delete index;
+  }
+
+  //Construct the index from the LZ77 parsing of the text. Blocks are
+  //resolved with Karp-Rabin fingerprints, so no suffix array is built.
+  st_att(text_offset_type m_tau, char_type *text, text_offset_type text_length,
+         const std::vector<pair_type> &parsing, std::uint64_t n_threads = 1,
+         bool m_pow2_blocks = false)
+  {
+    n = text_length;
+    tau = m_tau;
+    source_rmq = NULL;
+    t = text;
+    pow2_blocks = m_pow2_blocks;
+    make_attractors(parsing);
+    const std::uint64_t n_levels = make_block_lengths();
+    indexes.resize(n_levels);
+    offset_bits.resize(n_levels);
+    const std::uint64_t base = karp_rabin::random_base();
+    // Every thread lays out, resolves and packs one level at a time, so
+    // at most n_threads levels of blocks are in memory at once.
+    parallel_utils::work_stealing_for(n_levels, n_threads, 1,
+        [&](std::uint64_t l, std::uint64_t)
+        {
+          std::vector<linked_indexes<> *> pointers;
+          resolve_level_kr<char_type, text_offset_type>(text, make_level(l),
+              att_pos, n, base, pointers);
+          pack_level(l, pointers);
+        });
+    make_leaves(text, n_threads);
+    make_level_table();
+  }
+
+  //Query alphabet at anindex
+  char query(text_offset_type index) const {
+    return st_att_access(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), index);
+  }
+
+  //Query the alphabet at count positions, see st_att_access_batch
+  void query_batch(const text_offset_type *positions, std::uint64_t count,
+                   char_type *out, bool sort = false) const
+  {
+    st_att_access_batch(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), positions, count, out, sort);
+  }
+
+  //Answer a stream of queries with group_size of them in flight, see
+  //st_att_access_interleaved
+  template <typename source_type, typename sink_type>
+  void query_stream(source_type source, sink_type sink,
+                    std::uint64_t group_size = 16) const
+  {
+    st_att_access_interleaved(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), source, sink, group_size);
+  }
+
+  //Query the alphabet at count positions with group_size queries in flight
+  void query_interleaved(const text_offset_type *positions, std::uint64_t count,
+                         char_type *out, std::uint64_t group_size = 16) const
+  {
+    std::uint64_t next = 0;
+    query_stream(
+        [&](std::uint64_t &position)
+        {
+          if (next == count)
+            return false;
+          position = positions[next++];
+          return true;
+        },
+        [&](std::uint64_t i, char_type c) { out[i] = c; },
+        group_size);
+  }
+
+  //Query the alphabet at count positions using n_threads threads. Slices
+  //of the positions are handed out with work stealing and answered with
+  //query_interleaved.
+  void query_parallel(const text_offset_type *positions, std::uint64_t count,
+                      char_type *out, std::uint64_t n_threads) const
+  {
+    static const std::uint64_t slice = 1UL << 16;
+    parallel_utils::work_stealing_for((count + slice - 1) / slice, n_threads, 1,
+        [&](std::uint64_t task, std::uint64_t)
+        {
+          const std::uint64_t beg = task * slice;
+          query_interleaved(positions + beg, min(slice, count - beg), out + beg);
+        });
+  }
+
+  typedef st_att_iterator<char_type> const_iterator;
+  typedef st_att_iterator<char_type, true> const_reverse_iterator;
+
+  //Iterators over the text, see st_att_iterator
+  const_iterator begin() const
+  {
+    return const_iterator(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), n, 0);
+  }
+  const_iterator end() const
+  {
+    return const_iterator(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), n, n);
+  }
+  const_reverse_iterator rbegin() const
+  {
+    return const_reverse_iterator(level_table.data(), level_table.size() - 1,
+        leaves, window_base.words(), window_base.width(), n, n - 1);
+  }
+  const_reverse_iterator rend() const
+  {
+    return const_reverse_iterator(level_table.data(), level_table.size() - 1,
+        leaves, window_base.words(), window_base.width(), n, -1);
+  }
+
+  //Add the Karp-Rabin fingerprints with the given base used by fingerprint
+  //and lce. Let P(x) be the fingerprint of text[0..x). For a block at text
+  //position b whose pointer leads to an occurrence at text position s,
+  //P(b + o) = (P(b) - P(s)) * base^o + P(s + o), so every level stores
+  //P(b) - P(s) per block, and the last level P(b) per block of the
+  //windows. Blocks sticking out of the text start point to themselves and
+  //store 0. Needs 8 bytes per block and 8n bytes during construction.
+  void make_fingerprints(const char_type *text, std::uint64_t base,
+                         std::uint64_t n_threads = 1)
+  {
+    std::vector<std::uint64_t> prefix(n + 1);
+    prefix[0] = 0;
+    for (text_offset_type i = 0; i < n; i++)
+      prefix[i + 1] = karp_rabin::add(karp_rabin::mul(prefix[i], base),
+                                      (std::uint64_t)text[i] + 1);
+    fingerprint_base = base;
+    text_fingerprint = prefix[n];
+    powers = karp_rabin::power_table(base);
+
+    const std::uint64_t last_level = b_si.size() - 1;
+    block_fingerprints.assign(last_level + 1, std::vector<std::uint64_t>());
+    for (std::uint64_t l = 0; l <= last_level; l++)
+    {
+      const std::uint64_t count = (l < last_level) ? indexes[l].size() :
+          (l == 0) ? (n + b_si[0] - 1) / b_si[0] : att_pos.size() * 2 * tau;
+      std::vector<std::uint64_t> &fp = block_fingerprints[l];
+      fp.resize(count);
+      parallel_utils::parallel_for(0, count, n_threads,
+          [&](std::uint64_t beg, std::uint64_t end, std::uint64_t)
+          {
+            for (std::uint64_t i = beg; i < end; i++)
+            {
+              const text_offset_type b = block_start(l, i);
+              if (l == last_level)
+                fp[i] = prefix[max((text_offset_type)0, min(b, n))];
+              else if (b < 0 || b >= n)
+                fp[i] = 0;
+              else
+              {
+                const std::uint64_t pointer = indexes[l][i];
+                const text_offset_type src = att_pos[pointer >> offset_bits[l]] -
+                    (text_offset_type)(pointer & ((1UL << offset_bits[l]) - 1));
+                fp[i] = karp_rabin::sub(prefix[b], prefix[src]);
+              }
+            }
+          });
+    }
+  }
+
+  //Fingerprint of text[0..x) in O(levels) time. The walk is the one of
+  //query(x) and adds the term of the block it passes on every level.
+  std::uint64_t prefix_fingerprint(text_offset_type x) const
+  {
+    if (block_fingerprints.empty())
+    {
+      fprintf(stderr, "\nError: fingerprints were not made\n");
+      std::exit(EXIT_FAILURE);
+    }
+    if (x >= n)
+      return text_fingerprint;
+    const std::uint64_t last_level = level_table.size() - 1;
+    const st_att_level *level = level_table.data();
+    std::uint64_t block = (last_level == 0) ? x / level->block_len :
+                          level->divisor.divide(x);
+    std::uint64_t offset = x - block * level->block_len;
+    std::uint64_t attractor = 0, q = block;
+    std::uint64_t h = 0;
+    for (std::uint64_t l = 0; l < last_level; l++, level++)
+    {
+      h = karp_rabin::add(h, karp_rabin::mul(block_fingerprints[l][block],
+                                             powers(offset)));
+      const std::uint64_t pointer = packed_array::get(level->words, level->width, block);
+      attractor = pointer >> level->offset_bits;
+      const std::uint64_t rel = offset - (pointer & level->offset_mask) + level[1].window;
+      // The last level has no divisor, its block length may be 1.
+      q = (l + 1 == last_level) ? rel / level[1].block_len :
+                                  level[1].divisor.divide(rel);
+      offset = rel - q * level[1].block_len;
+      block = attractor * level[1].window_blocks + q;
+    }
+
+    // Add P(x) of the position reached in the last level: its block's P(b)
+    // and the leaf characters from the block start (or the text start) on.
+    const text_offset_type block_len = b_si[last_level];
+    const char_type *leaf = leaves + block * block_len;
+    text_offset_type b = block * block_len;
+    if (last_level > 0)
+    {
+      b = att_pos[attractor] - tau * block_len + (text_offset_type)q * block_len;
+      leaf = leaves + window_base[attractor] + q * block_len;
+    }
+    const text_offset_type s = max(b, (text_offset_type)0);
+    const text_offset_type y = b + (text_offset_type)offset;
+    return karp_rabin::add(h, karp_rabin::add(
+        karp_rabin::mul(block_fingerprints[last_level][block], powers(y - s)),
+        karp_rabin::fingerprint(leaf + (s - b), y - s, fingerprint_base)));
+  }
+
+  //Fingerprint of text[i..j), see make_fingerprints
+  std::uint64_t fingerprint(text_offset_type i, text_offset_type j) const
+  {
+    return karp_rabin::sub(prefix_fingerprint(j),
+        karp_rabin::mul(prefix_fingerprint(i), powers(j - i)));
+  }
+
+  //Largest len <= limit with equal(len), for equal true up to some length
+  //and false after it, by exponential and binary search
+  template <typename predicate_type>
+  static text_offset_type longest_match(text_offset_type limit,
+                                        const predicate_type &equal)
+  {
+    text_offset_type lo = 0, hi = 1;
+    while (hi <= limit && equal(hi))
+    {
+      lo = hi;
+      hi <<= 1;
+    }
+    hi = min(hi, limit + 1);
+    while (hi - lo > 1)
+    {
+      const text_offset_type mid = (lo + hi) / 2;
+      if (equal(mid))
+        lo = mid;
       else
-        break;
-      
+        hi = mid;
     }
-    for (text_offset_type i = 0; i < (text_offset_type)v.size(); i++)
+    return lo;
+  }
+
+  //Length of the longest common prefix of text[i..n) and text[j..n),
+  //found by exponential and binary search over fingerprints
+  text_offset_type lce(text_offset_type i, text_offset_type j) const
+  {
+    const text_offset_type limit = n - max(i, j);
+    if (i == j)
+      return limit;
+    const std::uint64_t pi = prefix_fingerprint(i);
+    const std::uint64_t pj = prefix_fingerprint(j);
+    return longest_match(limit, [&](text_offset_type len)
+        {
+          const std::uint64_t pw = powers(len);
+          return karp_rabin::sub(prefix_fingerprint(i + len), karp_rabin::mul(pi, pw)) ==
+                 karp_rabin::sub(prefix_fingerprint(j + len), karp_rabin::mul(pj, pw));
+        });
+  }
+
+  //Length of the longest common suffix of text[0..i) and text[0..j), up
+  //to limit
+  text_offset_type lcs(text_offset_type i, text_offset_type j,
+                       text_offset_type limit) const
+  {
+    if (i == j)
+      return limit;
+    const std::uint64_t pi = prefix_fingerprint(i);
+    const std::uint64_t pj = prefix_fingerprint(j);
+    return longest_match(limit, [&](text_offset_type len)
+        {
+          return karp_rabin::sub(pi, karp_rabin::mul(prefix_fingerprint(i - len),
+                                                     powers(len))) ==
+                 karp_rabin::sub(pj, karp_rabin::mul(prefix_fingerprint(j - len),
+                                                     powers(len)));
+        });
+  }
+
+  //Add the counts used by rank and select for every character of chars.
+  //With R(x) the number of occurrences in text[0..x), every block stores
+  //R of its start, relative to R of its window start below level 0. Every
+  //block whose pointer leads to s stores R(s) relative to the window start
+  //of the next level, so R(b + o) - R(b) = R(s + o) - R(s) is a difference
+  //of two ranks in that window. The leaves get a bit vector of the
+  //occurrences. Needs about 2 * log(tau * block length) bits per block and
+  //one bit per leaf character for every character, and 8n bytes during
+  //construction.
+  void make_char_counts(const char_type *text, const std::vector<char_type> &chars,
+                        std::uint64_t n_threads = 1)
+  {
+    const std::uint64_t last_level = b_si.size() - 1;
+    std::vector<std::uint64_t> rank(n + 1);
+    counts.assign(chars.size(), char_counts());
+    for (std::uint64_t k = 0; k < chars.size(); k++)
     {
-      Block<> bl = v[i];
-      char_type *s = new char_type[bl.len];
-      for (int64_t j = bl.start; j < bl.end; j++)
+      char_counts &cc = counts[k];
+      cc.c = chars[k];
+      rank[0] = 0;
+      for (text_offset_type i = 0; i < n; i++)
+        rank[i + 1] = rank[i] + (text[i] == cc.c);
+      cc.total = rank[n];
+      const auto R = [&](text_offset_type x)
       {
-        if (j >= 0 && j < (int64_t)n)
-          s[j - bl.start] = text[j];
-        else
-          s[j - bl.start] = '$';
+        return rank[max((text_offset_type)0, min(x, n))];
+      };
+
+      cc.block_rank.resize(last_level + 1);
+      cc.source_rank.resize(last_level);
+      std::vector<std::uint64_t> values;
+      for (std::uint64_t l = 0; l <= last_level; l++)
+      {
+        const std::uint64_t blocks = (l > 0) ? att_pos.size() * 2 * tau :
+            (n + b_si[0] - 1) / b_si[0];
+        const std::uint64_t max_value = (l > 0) ? 2 * tau * b_si[l] : n;
+        cc.block_rank[l] = packed_array(blocks, packed_array::bits_for(max_value));
+        for (std::uint64_t i = 0; i < blocks; i++)
+          cc.block_rank[l].set(i, R(block_start(l, i)) -
+              ((l > 0) ? R(block_start(l, i - i % (2 * tau))) : 0));
+        if (l == last_level)
+          break;
+
+        const text_offset_type window = tau * b_si[l + 1];
+        values.resize(indexes[l].size());
+        parallel_utils::parallel_for(0, values.size(), n_threads,
+            [&](std::uint64_t beg, std::uint64_t end, std::uint64_t)
+            {
+              for (std::uint64_t i = beg; i < end; i++)
+              {
+                const text_offset_type b = block_start(l, i);
+                values[i] = 0;
+                if (b >= n || b + b_si[l] <= 0)
+                  continue;
+                const std::uint64_t pointer = indexes[l][i];
+                const text_offset_type a = att_pos[pointer >> offset_bits[l]];
+                const text_offset_type src = a -
+                    (text_offset_type)(pointer & ((1UL << offset_bits[l]) - 1));
+                values[i] = R(src) - R(a - window);
+              }
+            });
+        cc.source_rank[l] = packed_array(values.size(),
+            packed_array::bits_for(2 * window));
+        for (std::uint64_t i = 0; i < values.size(); i++)
+          cc.source_rank[l].set(i, values[i]);
+      }
+
+      cc.leaf_bits.assign(leaf_length / 64 + 1, 0);
+      const text_offset_type w = (last_level == 0) ? 0 : tau * b_si[last_level];
+      const std::uint64_t windows = (last_level == 0) ? 1 : att_pos.size();
+      for (std::uint64_t a = 0; a < windows; a++)
+      {
+        const text_offset_type beg = (last_level == 0) ? 0 : att_pos[a] - w;
+        const std::uint64_t base = (last_level == 0) ? 0 : window_base[a];
+        const text_offset_type end = (last_level == 0) ? n : att_pos[a] + w;
+        for (text_offset_type j = max(beg, (text_offset_type)0); j < min(end, n); j++)
+          if (text[j] == cc.c)
+            cc.leaf_bits[(base + (j - beg)) >> 6] |= 1UL << ((base + (j - beg)) & 63);
       }
-      v_s.push_back(s);
-      
     }
-    v.clear();
-    att_pos.clear();
-    delete[] sa;
-    delete sa_rmq;
   }
 
-  char query(text_offset_type off, uint32_t level, text_offset_type attractor)
+  //Number of occurrences of c in text[0..x) in O(levels) time, without
+  //reading the leaves. It follows the walk of query(x) and on every level
+  //adds the rank of the block it enters and subtracts the rank of the
+  //source it comes from.
+  text_offset_type rank(char_type c, text_offset_type x) const
   {
-    text_offset_type block_position, offset, block_len = b_si[level];
-    if (level == 0)
+    const char_counts &cc = counts_of(c);
+    if (x >= n)
+      return cc.total;
+    const std::uint64_t last_level = level_table.size() - 1;
+    const st_att_level *level = level_table.data();
+    std::uint64_t block = (last_level == 0) ? x / level->block_len :
+                          level->divisor.divide(x);
+    std::uint64_t offset = x - block * level->block_len;
+    std::uint64_t result = cc.block_rank[0][block];
+    std::uint64_t leaf = x;
+    for (std::uint64_t l = 0; l < last_level; l++, level++)
     {
-      block_position = off / block_len;
-      offset = off % block_len;
+      const std::uint64_t pointer = packed_array::get(level->words, level->width, block);
+      const std::uint64_t attractor = pointer >> level->offset_bits;
+      const std::uint64_t rel = offset - (pointer & level->offset_mask) + level[1].window;
+      const std::uint64_t q = (l + 1 == last_level) ? rel / level[1].block_len :
+                                                      level[1].divisor.divide(rel);
+      result -= cc.source_rank[l][block];
+      block = attractor * level[1].window_blocks + q;
+      offset = rel - q * level[1].block_len;
+      result += cc.block_rank[l + 1][block];
+      leaf = window_base[attractor] + rel;
     }
-    else
+    return result + count_bits(cc.leaf_bits.data(), leaf - offset, leaf);
+  }
+
+  //Position of the k-th (from 0) occurrence of c, or n if there are at most
+  //k. The level-0 block is found by binary search over the level-0 ranks.
+  //Below, the source of a block spans at most tau + 1 blocks of the next
+  //level, among which the one holding the occurrence is found by its rank.
+  text_offset_type select(char_type c, text_offset_type k) const
+  {
+    const char_counts &cc = counts_of(c);
+    if ((std::uint64_t)k >= cc.total)
+      return n;
+    const packed_array &start_rank = cc.block_rank[0];
+    std::uint64_t lo = 0, hi = start_rank.size();
+    while (hi - lo > 1)
+    {
+      const std::uint64_t mid = (lo + hi) / 2;
+      if (start_rank[mid] <= (std::uint64_t)k)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    const std::uint64_t last_level = level_table.size() - 1;
+    std::uint64_t block = lo;
+    std::uint64_t rest = k - start_rank[block];
+    text_offset_type shift = (text_offset_type)block * b_si[0];
+    std::uint64_t leaf = shift;
+    for (std::uint64_t l = 0; l < last_level; l++)
+    {
+      const st_att_level &next = level_table[l + 1];
+      const packed_array &next_rank = cc.block_rank[l + 1];
+      const std::uint64_t pointer = indexes[l][block];
+      const std::uint64_t attractor = pointer >> offset_bits[l];
+      const std::uint64_t rel = next.window - (pointer & level_table[l].offset_mask);
+      const std::uint64_t first = attractor * next.window_blocks;
+      std::uint64_t q = rel / next.block_len;
+      rest += cc.source_rank[l][block];
+      while (q + 1 < next.window_blocks && next_rank[first + q + 1] <= rest)
+        q++;
+      block = first + q;
+      rest -= next_rank[block];
+      shift += (text_offset_type)(q * next.block_len) - (text_offset_type)rel;
+      leaf = window_base[attractor] + q * next.block_len;
+    }
+    return shift + (select_bit(cc.leaf_bits.data(), leaf, rest) - leaf);
+  }
+
+  //Add the structures used by count and locate, after Navarro and Prezza.
+  //An occurrence is primary if it contains an attractor. Splitting it at
+  //its first attractor a into P[0..k) and P[k..m), P[0..k) is a suffix of
+  //the phrase part before a and P[k..m) a prefix of text[a..n). Attractors
+  //are sorted by both strings, which makes the primary occurrences of a
+  //split the points of a grid range. Every other occurrence lies inside
+  //an LZ77 phrase minus its last character and is a copy of an earlier
+  //occurrence in the phrase source. Strings are compared with the
+  //fingerprints, which are made first if they were not.
+  void make_search_index(const char_type *text, std::uint64_t n_threads = 1)
+  {
+    if (phrase_src.size() != (std::uint64_t)gamma)
     {
-      block_position = attractor * tau * 2 + tau + (off - attractor) / block_len;
-      offset = (off - attractor) % block_len;
-      if (offset < 0)
+      fprintf(stderr, "\nError: the search index needs the LZ77 attractor\n");
+      std::exit(EXIT_FAILURE);
+    }
+    if (block_fingerprints.empty())
+      make_fingerprints(text, karp_rabin::random_base(), n_threads);
+    const auto phrase_part = [&](std::uint64_t i)
+    {
+      return att_pos[i] - (i ? att_pos[i - 1] : -1) - 1;
+    };
+
+    // Sort the attractors by the reversed phrase part before them and by
+    // the suffix starting at them.
+    std::vector<std::uint64_t> left(gamma), right(gamma), right_rank(gamma);
+    for (text_offset_type i = 0; i < gamma; i++)
+      left[i] = right[i] = i;
+    std::sort(left.begin(), left.end(), [&](std::uint64_t i, std::uint64_t j)
+        {
+          const text_offset_type a = att_pos[i], b = att_pos[j];
+          const text_offset_type len_i = phrase_part(i), len_j = phrase_part(j);
+          const text_offset_type len = lcs(a, b, min(len_i, len_j));
+          if (len == min(len_i, len_j))
+            return len_i < len_j;
+          return (char_type)query(a - 1 - len) < (char_type)query(b - 1 - len);
+        });
+    std::sort(right.begin(), right.end(), [&](std::uint64_t i, std::uint64_t j)
+        {
+          const text_offset_type a = att_pos[i], b = att_pos[j];
+          const text_offset_type len = lce(a, b);
+          if (a + len == n || b + len == n)
+            return a + len == n;
+          return (char_type)query(a + len) < (char_type)query(b + len);
+        });
+    left_order = packed_array(gamma, attractor_bits);
+    right_order = packed_array(gamma, attractor_bits);
+    for (text_offset_type i = 0; i < gamma; i++)
+    {
+      left_order.set(i, left[i]);
+      right_order.set(i, right[i]);
+      right_rank[right[i]] = i;
+    }
+    for (text_offset_type i = 0; i < gamma; i++)
+      left[i] = right_rank[left[i]];
+    grid = wavelet_matrix(left, attractor_bits);
+
+    // Sort the sources of phrases longer than one by their start.
+    std::vector<std::pair<text_offset_type, std::uint64_t> > sources;
+    for (text_offset_type i = 0; i < gamma; i++)
+      if (phrase_src[i] >= 0 && phrase_part(i) > 0)
+        sources.push_back(std::make_pair(phrase_src[i], (std::uint64_t)i));
+    std::sort(sources.begin(), sources.end());
+    source_beg.resize(sources.size());
+    source_phrase.resize(sources.size());
+    source_key.resize(sources.size());
+    for (std::uint64_t i = 0; i < sources.size(); i++)
+    {
+      const std::uint64_t phrase = sources[i].second;
+      source_beg[i] = sources[i].first;
+      source_phrase[i] = phrase;
+      source_key[i] = n - (source_beg[i] + phrase_part(phrase));
+    }
+    delete source_rmq;
+    source_rmq = sources.empty() ? NULL :
+        new rmq_type(source_key.data(), source_key.size());
+  }
+
+  //Starting positions of the occurrences of pattern[0..m), in no particular
+  //order. For every split of the pattern, the attractor ranges are found
+  //by binary search comparing with fingerprints, after which every
+  //occurrence costs O(log gamma) time.
+  std::vector<text_offset_type> locate(const char_type *pattern, std::uint64_t m) const
+  {
+    std::vector<text_offset_type> occ;
+    if (m == 0 || m > (std::uint64_t)n)
+      return occ;
+    if (left_order.size() != (std::uint64_t)gamma)
+    {
+      fprintf(stderr, "\nError: the search index was not made\n");
+      std::exit(EXIT_FAILURE);
+    }
+    std::vector<std::uint64_t> prefix(m + 1, 0);
+    for (std::uint64_t i = 0; i < m; i++)
+      prefix[i + 1] = karp_rabin::add(karp_rabin::mul(prefix[i], fingerprint_base),
+                                      (std::uint64_t)pattern[i] + 1);
+    const auto pattern_fingerprint = [&](std::uint64_t i, std::uint64_t j)
+    {
+      return karp_rabin::sub(prefix[j], karp_rabin::mul(prefix[i], powers(j - i)));
+    };
+
+    // First position of order in [0, gamma) whose string is not smaller
+    // than the pattern part, or larger if upper is set.
+    const auto search = [&](const packed_array &order, bool upper,
+                            const std::function<int(std::uint64_t)> &compare)
+    {
+      std::uint64_t lo = 0, hi = gamma;
+      while (lo < hi)
       {
-        block_position--;
-        offset += block_len;
+        const std::uint64_t mid = (lo + hi) / 2;
+        const int c = compare(order[mid]);
+        if (c < 0 || (upper && c == 0))
+          lo = mid + 1;
+        else
+          hi = mid;
       }
+      return lo;
+    };
+
+    for (std::uint64_t k = 0; k < m; k++)
+    {
+      // Compare the reversed phrase part before attractor i with the
+      // reversed P[0..k).
+      const std::function<int(std::uint64_t)> compare_left = [&](std::uint64_t i)
+      {
+        const text_offset_type a = att_pos[i];
+        const text_offset_type part = a - (i ? att_pos[i - 1] : -1) - 1;
+        const std::uint64_t pa = prefix_fingerprint(a);
+        const text_offset_type len = longest_match(min(part, (text_offset_type)k),
+            [&](text_offset_type l)
+            {
+              return karp_rabin::sub(pa, karp_rabin::mul(prefix_fingerprint(a - l),
+                  powers(l))) == pattern_fingerprint(k - l, k);
+            });
+        if (len == (text_offset_type)k)
+          return 0;
+        if (len == part)
+          return -1;
+        return ((char_type)query(a - 1 - len) < pattern[k - 1 - len]) ? -1 : 1;
+      };
+      const std::uint64_t x_beg = search(left_order, false, compare_left);
+      const std::uint64_t x_end = search(left_order, true, compare_left);
+      if (x_beg == x_end)
+        continue;
+
+      // Compare the suffix starting at attractor i with P[k..m).
+      const std::function<int(std::uint64_t)> compare_right = [&](std::uint64_t i)
+      {
+        const text_offset_type a = att_pos[i];
+        const std::uint64_t pa = prefix_fingerprint(a);
+        const text_offset_type len = longest_match(min(n - a, (text_offset_type)(m - k)),
+            [&](text_offset_type l)
+            {
+              return karp_rabin::sub(prefix_fingerprint(a + l), karp_rabin::mul(pa,
+                  powers(l))) == pattern_fingerprint(k, k + l);
+            });
+        if (len == (text_offset_type)(m - k))
+          return 0;
+        if (a + len == n)
+          return -1;
+        return ((char_type)query(a + len) < pattern[k + len]) ? -1 : 1;
+      };
+      const std::uint64_t y_beg = search(right_order, false, compare_right);
+      const std::uint64_t y_end = search(right_order, true, compare_right);
+      grid.report(x_beg, x_end, y_beg, y_end, [&](std::uint64_t y)
+          {
+            occ.push_back(att_pos[right_order[y]] - k);
+          });
     }
-    if (level == b_si.size() - 1)
-     return  v_s[block_position][offset];
 
-    linked_indexes<> *l = indexes[level][block_position];
+    // Copy every occurrence into the phrases whose source contains it.
+    std::vector<std::pair<std::uint64_t, std::uint64_t> > ranges;
+    for (std::uint64_t i = 0; i < occ.size() && source_rmq != NULL; i++)
+    {
+      const text_offset_type p = occ[i];
+      const std::uint64_t threshold = n - (p + m) + 1;
+      ranges.push_back(std::make_pair(0UL, (std::uint64_t)(std::upper_bound(
+          source_beg.begin(), source_beg.end(), p) - source_beg.begin())));
+      while (!ranges.empty())
+      {
+        const std::uint64_t beg = ranges.back().first, end = ranges.back().second;
+        ranges.pop_back();
+        if (beg >= end)
+          continue;
+        const std::uint64_t j = source_rmq->rmq(beg, end);
+        if ((std::uint64_t)source_key[j] >= threshold)
+          continue;
+        const std::uint64_t phrase = source_phrase[j];
+        occ.push_back((phrase ? att_pos[phrase - 1] + 1 : 0) + p - source_beg[j]);
+        ranges.push_back(std::make_pair(beg, j));
+        ranges.push_back(std::make_pair(j + 1, end));
+      }
+    }
+    return occ;
+  }
 
-    return query(
-        l->start() + offset,
-        level + 1,
-        l->p.first);
+  //Number of occurrences of pattern[0..m), see locate
+  std::uint64_t count(const char_type *pattern, std::uint64_t m) const
+  {
+    return locate(pattern, m).size();
   }
-  //Query alphabet at anindex
-  char query(text_offset_type index){
-    return query(index,0,-1);
+
+  //Copy text[start..start + len) to out, see st_att_extract
+  void query(text_offset_type start, text_offset_type len, char_type *out) const {
+    st_att_extract(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), start, len, out);
+  }
+
+  //Write the whole text to out using n_threads threads, see
+  //st_att_decompress
+  void decompress(char_type *out, std::uint64_t n_threads) const
+  {
+    st_att_decompress(level_table.data(), level_table.size() - 1, leaves,
+        window_base.words(), window_base.width(), n, out, n_threads);
+  }
+
+  //Number of attractor positions
+  text_offset_type attractor_count() const
+  {
+    return gamma;
+  }
+
+  //Size of the index in bytes, as written by write
+  std::uint64_t size_in_bytes() const
+  {
+    std::uint64_t bytes = sizeof(st_att_file_header) + 8 * b_si.size() +
+        8 * offset_bits.size() + leaf_length * sizeof(char_type);
+    for (std::uint64_t i = 0; i + 1 < b_si.size(); i++)
+      bytes += 8 + 8 * indexes[i].n_words();
+    if (b_si.size() > 1)
+      bytes += 8 * window_base.n_words();
+    return bytes;
+  }
+
+  //Write the index to a file that can be mapped back with mapped_st_att
+  void write(const std::string &filename) const
+  {
+    st_att_file_header header;
+    header.magic = st_att_file_header::file_magic;
+    header.version = st_att_file_header::file_version;
+    header.text_length = n;
+    header.tau = tau;
+    header.alpha = alpha;
+    header.gamma = gamma;
+    header.levels = b_si.size();
+    header.leaf_length = leaf_length;
+    header.window_bits = window_base.width();
+    header.attractor_bits = attractor_bits;
+
+    std::FILE * const f = utils::file_open(filename, "w");
+    utils::write_to_file(&header, 1, f);
+    for (std::uint64_t i = 0; i < header.levels; i++)
+    {
+      const std::int64_t block_len = b_si[i];
+      utils::write_to_file(&block_len, 1, f);
+    }
+    for (std::uint64_t i = 0; i + 1 < header.levels; i++)
+    {
+      const std::uint64_t level_size = indexes[i].size();
+      utils::write_to_file(&level_size, 1, f);
+    }
+    if (header.levels > 1)
+      utils::write_to_file(offset_bits.data(), offset_bits.size(), f);
+    for (std::uint64_t i = 0; i + 1 < header.levels; i++)
+      utils::write_to_file(indexes[i].words(), indexes[i].n_words(), f);
+    if (header.levels > 1)
+      utils::write_to_file(window_base.words(), window_base.n_words(), f);
+    utils::write_to_file(leaves, leaf_length, f);
+    std::fclose(f);
   }
   ~st_att(){
-    for(unsigned long i=0;i<indexes.size();i++){
-      for(unsigned long j=0;j<indexes[i].size();j++)
-        delete(indexes[i][j]);
-    }
-    indexes.clear();
-    for(unsigned long i=0;i<v_s.size();i++)
-      delete []v_s[i];
-    v_s.clear();
+    delete source_rmq;
+    utils::aligned_deallocate(leaves);
+  }
+};
+
+//=============================================================================
+// The string attractor index with tau fixed at compile time to a power of
+// two and all block lengths powers of two, so that queries use shifts and
+// masks only. The level 0 block length is rounded down, which adds at most
+// gamma level 0 blocks; rounding up would double the leaf windows instead.
+//=============================================================================
+template <
+    std::uint64_t tau_value,
+    typename char_type = std::uint8_t,
+    typename text_offset_type = std::int64_t,
+    typename sa_offset_type = std::uint64_t,
+    typename rmq_type = rmq_tree<sa_offset_type> >
+class st_att_pow2 : public st_att<char_type, text_offset_type, sa_offset_type, rmq_type>
+{
+  typedef st_att<char_type, text_offset_type, sa_offset_type, rmq_type> base_type;
+  static_assert(tau_value >= 2 && (tau_value & (tau_value - 1)) == 0,
+                "tau must be a power of two");
+  static const std::uint64_t log_tau =
+      (tau_value == 2) ? 1 : (tau_value == 4) ? 2 : (tau_value == 8) ? 3 :
+      (tau_value == 16) ? 4 : (tau_value == 32) ? 5 : 6;
+  static_assert((1UL << log_tau) == tau_value, "tau must be at most 64");
+
+public:
+  typedef typename base_type::pair_type pair_type;
+
+  st_att_pow2(char_type *text, text_offset_type text_length,
+              std::uint64_t n_threads = 1)
+      : base_type(tau_value, text, text_length, n_threads, true) {}
+
+  st_att_pow2(char_type *text, text_offset_type text_length,
+              const std::vector<pair_type> &parsing, std::uint64_t n_threads = 1)
+      : base_type(tau_value, text, text_length, parsing, n_threads, true) {}
+
+  using base_type::query;
+
+  //Query alphabet at an index
+  char query(text_offset_type index) const
+  {
+    return st_att_access_pow2<log_tau>(this->level_table.data(),
+        this->level_table.size() - 1, this->leaves,
+        this->window_base.words(), this->window_base.width(), index);
+  }
+};
+
+//=============================================================================
+// Read-only view of an index written by st_att::write. The file is mapped
+// into memory and queries read the level pointers and leaf strings in place,
+// so opening an index costs a single mmap instead of a full construction.
+// As with st_att, queries may run from many threads at once.
+//=============================================================================
+template <
+    typename char_type = std::uint8_t,
+    typename text_offset_type = std::int64_t>
+class mapped_st_att
+{
+private:
+  const void *data;
+  std::uint64_t size;
+  const st_att_file_header *header;
+  const std::int64_t *b_si;
+  const std::uint64_t *offset_bits;
+  std::vector<const std::uint64_t *> indexes;
+  const std::uint64_t *window_base;
+  const char_type *leaves;
+  std::vector<st_att_level> level_table;
+
+public:
+  mapped_st_att(const std::string &filename)
+  {
+    data = utils::map_file(filename, size);
+    if (size < sizeof(st_att_file_header))
+    {
+      fprintf(stderr, "\nError: %s is not an st_att index\n",
+              filename.c_str());
+      std::exit(EXIT_FAILURE);
+    }
+    header = (const st_att_file_header *)data;
+    if (header->magic != st_att_file_header::file_magic)
+    {
+      fprintf(stderr, "\nError: %s is not an st_att index\n",
+              filename.c_str());
+      std::exit(EXIT_FAILURE);
+    }
+    if (header->version != st_att_file_header::file_version)
+    {
+      fprintf(stderr, "\nError: %s has version %lu, expected %lu\n",
+              filename.c_str(), (std::uint64_t)header->version,
+              (std::uint64_t)st_att_file_header::file_version);
+      std::exit(EXIT_FAILURE);
+    }
+
+    // Locate the sections. Sizes are checked before every step so that
+    // a truncated file is reported instead of read past its end.
+    const std::uint64_t levels = header->levels;
+    std::uint64_t expected = sizeof(st_att_file_header) +
+                             (3 * levels - 2) * sizeof(std::int64_t);
+    if (levels == 0 || size < expected)
+    {
+      fprintf(stderr, "\nError: %s is truncated\n", filename.c_str());
+      std::exit(EXIT_FAILURE);
+    }
+    b_si = (const std::int64_t *)(header + 1);
+    const std::uint64_t *level_size = (const std::uint64_t *)(b_si + levels);
+    offset_bits = level_size + levels - 1;
+    const std::uint64_t *ptr = offset_bits + levels - 1;
+    for (std::uint64_t i = 0; i + 1 < levels; i++)
+    {
+      const std::uint64_t words = packed_array::words_for(level_size[i],
+          header->attractor_bits + offset_bits[i]);
+      expected += words * sizeof(std::uint64_t);
+      indexes.push_back(ptr);
+      ptr += words;
+    }
+    window_base = ptr;
+    if (levels > 1)
+    {
+      const std::uint64_t words = packed_array::words_for(header->gamma,
+          header->window_bits);
+      expected += words * sizeof(std::uint64_t);
+      ptr += words;
+    }
+    expected += header->leaf_length * sizeof(char_type);
+    if (size < expected)
+    {
+      fprintf(stderr, "\nError: %s is truncated\n", filename.c_str());
+      std::exit(EXIT_FAILURE);
+    }
+    leaves = (const char_type *)ptr;
+
+    level_table.resize(levels);
+    for (std::uint64_t l = 0; l < levels; l++)
+    {
+      st_att_level &lv = level_table[l];
+      lv.block_len = b_si[l];
+      lv.window = (l == 0) ? 0 : header->tau * b_si[l];
+      lv.window_blocks = 2 * header->tau;
+      lv.block_shift = packed_array::bits_for(b_si[l]) - 1;
+      if (l + 1 == levels)
+        continue;
+      lv.words = indexes[l];
+      lv.width = header->attractor_bits + offset_bits[l];
+      lv.offset_bits = offset_bits[l];
+      lv.offset_mask = (1UL << offset_bits[l]) - 1;
+      lv.divisor = fast_divisor(b_si[l]);
+    }
+  }
+
+  text_offset_type text_length() const
+  {
+    return header->text_length;
+  }
+
+  //Query alphabet at an index
+  char query(text_offset_type index) const
+  {
+    return st_att_access(level_table.data(), header->levels - 1, leaves,
+        window_base, header->window_bits, index);
+  }
+
+  //Query the alphabet at count positions, see st_att_access_batch
+  void query_batch(const text_offset_type *positions, std::uint64_t count,
+                   char_type *out, bool sort = false) const
+  {
+    st_att_access_batch(level_table.data(), header->levels - 1, leaves,
+        window_base, header->window_bits, positions, count, out, sort);
+  }
+
+  //Answer a stream of queries with group_size of them in flight, see
+  //st_att_access_interleaved
+  template <typename source_type, typename sink_type>
+  void query_stream(source_type source, sink_type sink,
+                    std::uint64_t group_size = 16) const
+  {
+    st_att_access_interleaved(level_table.data(), header->levels - 1, leaves,
+        window_base, header->window_bits, source, sink, group_size);
+  }
+
+  //Query the alphabet at count positions with group_size queries in flight
+  void query_interleaved(const text_offset_type *positions, std::uint64_t count,
+                         char_type *out, std::uint64_t group_size = 16) const
+  {
+    std::uint64_t next = 0;
+    query_stream(
+        [&](std::uint64_t &position)
+        {
+          if (next == count)
+            return false;
+          position = positions[next++];
+          return true;
+        },
+        [&](std::uint64_t i, char_type c) { out[i] = c; },
+        group_size);
+  }
+
+  //Query the alphabet at count positions using n_threads threads, as
+  //st_att::query_parallel does
+  void query_parallel(const text_offset_type *positions, std::uint64_t count,
+                      char_type *out, std::uint64_t n_threads) const
+  {
+    static const std::uint64_t slice = 1UL << 16;
+    parallel_utils::work_stealing_for((count + slice - 1) / slice, n_threads, 1,
+        [&](std::uint64_t task, std::uint64_t)
+        {
+          const std::uint64_t beg = task * slice;
+          query_interleaved(positions + beg, min(slice, count - beg), out + beg);
+        });
+  }
+
+  typedef st_att_iterator<char_type> const_iterator;
+  typedef st_att_iterator<char_type, true> const_reverse_iterator;
+
+  //Iterators over the text, see st_att_iterator
+  const_iterator begin() const
+  {
+    return const_iterator(level_table.data(), header->levels - 1, leaves,
+        window_base, header->window_bits, header->text_length, 0);
+  }
+  const_iterator end() const
+  {
+    return const_iterator(level_table.data(), header->levels - 1, leaves,
+        window_base, header->window_bits, header->text_length,
+        header->text_length);
+  }
+  const_reverse_iterator rbegin() const
+  {
+    return const_reverse_iterator(level_table.data(), header->levels - 1,
+        leaves, window_base, header->window_bits, header->text_length,
+        (std::int64_t)header->text_length - 1);
+  }
+  const_reverse_iterator rend() const
+  {
+    return const_reverse_iterator(level_table.data(), header->levels - 1,
+        leaves, window_base, header->window_bits, header->text_length, -1);
+  }
+
+  //Copy text[start..start + len) to out, see st_att_extract
+  void query(text_offset_type start, text_offset_type len, char_type *out) const
+  {
+    st_att_extract(level_table.data(), header->levels - 1, leaves, window_base,
+        header->window_bits, start, len, out);
+  }
+
+  //Write the whole text to out using n_threads threads, see
+  //st_att_decompress
+  void decompress(char_type *out, std::uint64_t n_threads) const
+  {
+    st_att_decompress(level_table.data(), header->levels - 1, leaves, window_base,
+        header->window_bits, header->text_length, out, n_threads);
+  }
+
+  ~mapped_st_att()
+  {
+    utils::unmap_file(data, size);
   }
 };
 
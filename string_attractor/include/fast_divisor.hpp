@@ -0,0 +1,89 @@
+/**
+ * @file    fast_divisor.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __FAST_DIVISOR_HPP_INCLUDED
+#define __FAST_DIVISOR_HPP_INCLUDED
+
+#include <cstdint>
+
+
+//=============================================================================
+// Division of 64-bit unsigned integers by a divisor d >= 2 fixed at runtime,
+// using a precomputed magic number (the branchfree scheme of libdivide).
+// A quotient costs one high multiplication, a subtraction and two shifts.
+//=============================================================================
+class fast_divisor {
+  private:
+    __extension__ typedef unsigned __int128 uint128_type;
+
+    std::uint64_t m_magic;
+    std::uint64_t m_shift;
+
+  public:
+    fast_divisor()
+      : m_magic(0),
+        m_shift(0) {}
+
+    fast_divisor(const std::uint64_t d) {
+      std::uint64_t log = 63;
+      while (!(d >> log))
+        --log;
+      if ((d & (d - 1)) == 0) {
+        m_magic = 0;
+        m_shift = log - 1;
+      } else {
+
+        // m = 2 * floor(2^(64 + log) / d) + 1 + [2 * remainder >= d].
+        const uint128_type numerator = (uint128_type)1 << (64 + log);
+        std::uint64_t magic = (std::uint64_t)(numerator / d);
+        const std::uint64_t rem = (std::uint64_t)(numerator % d);
+        magic += magic;
+        const std::uint64_t twice_rem = rem + rem;
+        if (twice_rem >= d || twice_rem < rem)
+          ++magic;
+        m_magic = magic + 1;
+        m_shift = log;
+      }
+    }
+
+    //=========================================================================
+    // Return floor(n / d).
+    //=========================================================================
+    inline std::uint64_t divide(const std::uint64_t n) const {
+      const std::uint64_t q =
+        (std::uint64_t)(((uint128_type)m_magic * n) >> 64);
+      return (((n - q) >> 1) + q) >> m_shift;
+    }
+};
+
+#endif  // __FAST_DIVISOR_HPP_INCLUDED
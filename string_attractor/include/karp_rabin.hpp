@@ -0,0 +1,180 @@
+/**
+ * @file    karp_rabin.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __KARP_RABIN_HPP_INCLUDED
+#define __KARP_RABIN_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+#include "utils.hpp"
+
+
+//=============================================================================
+// Karp-Rabin fingerprints modulo the Mersenne prime 2^61 - 1. The
+// fingerprint of s[0..m) is sum (s[i] + 1) * base^(m - 1 - i), so that
+// fp(AB) = fp(A) * base^|B| + fp(B).
+//=============================================================================
+namespace karp_rabin {
+
+static const std::uint64_t prime = (1UL << 61) - 1;
+
+inline std::uint64_t mul(
+    const std::uint64_t a,
+    const std::uint64_t b) {
+  __extension__ typedef unsigned __int128 uint128_type;
+  const uint128_type p = (uint128_type)a * b;
+  const std::uint64_t r = (std::uint64_t)(p & prime) + (std::uint64_t)(p >> 61);
+  return (r >= prime) ? r - prime : r;
+}
+
+inline std::uint64_t add(
+    const std::uint64_t a,
+    const std::uint64_t b) {
+  const std::uint64_t r = a + b;
+  return (r >= prime) ? r - prime : r;
+}
+
+inline std::uint64_t sub(
+    const std::uint64_t a,
+    const std::uint64_t b) {
+  return (a >= b) ? a - b : a + prime - b;
+}
+
+inline std::uint64_t pow(
+    std::uint64_t base,
+    std::uint64_t exp) {
+  std::uint64_t result = 1;
+  while (exp > 0) {
+    if (exp & 1)
+      result = mul(result, base);
+    base = mul(base, base);
+    exp >>= 1;
+  }
+  return result;
+}
+
+inline std::uint64_t random_base() {
+  return utils::random_int<std::uint64_t>(
+      (std::uint64_t)256, prime - 1);
+}
+
+//=============================================================================
+// Compute the fingerprint of s[0..length).
+//=============================================================================
+template<typename char_type>
+std::uint64_t fingerprint(
+    const char_type * const s,
+    const std::uint64_t length,
+    const std::uint64_t base) {
+  std::uint64_t h = 0;
+  for (std::uint64_t i = 0; i < length; ++i)
+    h = add(mul(h, base), (std::uint64_t)s[i] + 1);
+  return h;
+}
+
+//=============================================================================
+// Fingerprint of a window of fixed length sliding over a text.
+//=============================================================================
+template<typename char_type>
+struct rolling_hash {
+  const char_type * const text;
+  const std::uint64_t length;
+  const std::uint64_t base;
+  const std::uint64_t top;
+  std::uint64_t pos;
+  std::uint64_t hash;
+
+  // Start with the window text[0..length).
+  rolling_hash(
+      const char_type * const m_text,
+      const std::uint64_t m_length,
+      const std::uint64_t m_base)
+    : text(m_text),
+      length(m_length),
+      base(m_base),
+      top(pow(m_base, m_length - 1)),
+      pos(0),
+      hash(fingerprint(m_text, m_length, m_base)) {}
+
+  // Move the window one position to the right.
+  inline void roll() {
+    hash = sub(hash, mul((std::uint64_t)text[pos] + 1, top));
+    hash = add(mul(hash, base), (std::uint64_t)text[pos + length] + 1);
+    ++pos;
+  }
+};
+
+//=============================================================================
+// Powers of a base in O(1): base^e = low[e mod 2^11] * mid[(e >> 11) mod
+// 2^11] * high[e >> 22] for e < 2^33, in three tables of 16 KiB each.
+//=============================================================================
+class power_table {
+  private:
+    static const std::uint64_t bits = 11;
+    std::uint64_t m_base;
+    std::vector<std::uint64_t> m_low;
+    std::vector<std::uint64_t> m_mid;
+    std::vector<std::uint64_t> m_high;
+
+  public:
+    power_table()
+      : m_base(0) {}
+
+    power_table(const std::uint64_t base)
+      : m_base(base),
+        m_low(1UL << bits),
+        m_mid(1UL << bits),
+        m_high(1UL << bits) {
+      const std::uint64_t mid_step = karp_rabin::pow(base, 1UL << bits);
+      const std::uint64_t high_step = karp_rabin::pow(mid_step, 1UL << bits);
+      m_low[0] = m_mid[0] = m_high[0] = 1;
+      for (std::uint64_t i = 1; i < (1UL << bits); ++i) {
+        m_low[i] = mul(m_low[i - 1], base);
+        m_mid[i] = mul(m_mid[i - 1], mid_step);
+        m_high[i] = mul(m_high[i - 1], high_step);
+      }
+    }
+
+    inline std::uint64_t operator()(const std::uint64_t e) const {
+      if (e >> (3 * bits))
+        return karp_rabin::pow(m_base, e);
+      const std::uint64_t mask = (1UL << bits) - 1;
+      return mul(mul(m_low[e & mask], m_mid[(e >> bits) & mask]),
+          m_high[e >> (2 * bits)]);
+    }
+};
+
+}  // namespace karp_rabin
+
+#endif  // __KARP_RABIN_HPP_INCLUDED
@@ -0,0 +1,140 @@
+/**
+ * @file    packed_array.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __PACKED_ARRAY_HPP_INCLUDED
+#define __PACKED_ARRAY_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+
+//=============================================================================
+// Array of unsigned integers of a fixed bit width, stored back to back in
+// 64-bit words. One padding word is kept at the end, so that an element
+// is always read with two unconditional loads.
+//=============================================================================
+class packed_array {
+  private:
+    std::uint64_t m_size;
+    std::uint64_t m_width;
+    std::vector<std::uint64_t> m_words;
+
+  public:
+
+    //=========================================================================
+    // Number of words used by n elements of the given width.
+    //=========================================================================
+    static inline std::uint64_t words_for(
+        const std::uint64_t n,
+        const std::uint64_t width) {
+      return (n * width + 63) / 64 + 1;
+    }
+
+    //=========================================================================
+    // Return the number of bits needed to store values up to max_value.
+    //=========================================================================
+    static inline std::uint64_t bits_for(std::uint64_t max_value) {
+      std::uint64_t width = 1;
+      while (width < 64 && (max_value >> width) > 0)
+        ++width;
+      return width;
+    }
+
+    //=========================================================================
+    // Return the i-th element of the array of given width stored at words.
+    //=========================================================================
+    static inline std::uint64_t get(
+        const std::uint64_t * const words,
+        const std::uint64_t width,
+        const std::uint64_t i) {
+      const std::uint64_t bit = i * width;
+      const std::uint64_t word = bit >> 6;
+      const std::uint64_t shift = bit & 63;
+      const std::uint64_t value = (words[word] >> shift) |
+        ((words[word + 1] << 1) << (63 - shift));
+      return (width == 64) ? value : value & ((1UL << width) - 1);
+    }
+
+    packed_array()
+      : m_size(0),
+        m_width(1),
+        m_words(1, 0) {}
+
+    packed_array(
+        const std::uint64_t size,
+        const std::uint64_t width)
+      : m_size(size),
+        m_width(width),
+        m_words(words_for(size, width), 0) {}
+
+    //=========================================================================
+    // Set the i-th element. Assumes value fits in width bits.
+    //=========================================================================
+    inline void set(
+        const std::uint64_t i,
+        const std::uint64_t value) {
+      const std::uint64_t bit = i * m_width;
+      const std::uint64_t word = bit >> 6;
+      const std::uint64_t shift = bit & 63;
+      const std::uint64_t mask = (m_width == 64) ?
+        ~0UL : ((1UL << m_width) - 1);
+      m_words[word] = (m_words[word] & ~(mask << shift)) | (value << shift);
+      if (shift + m_width > 64) {
+        const std::uint64_t high = 64 - shift;
+        m_words[word + 1] = (m_words[word + 1] & ~(mask >> high)) |
+          (value >> high);
+      }
+    }
+
+    inline std::uint64_t operator[](const std::uint64_t i) const {
+      return get(m_words.data(), m_width, i);
+    }
+
+    inline std::uint64_t size() const {
+      return m_size;
+    }
+
+    inline std::uint64_t width() const {
+      return m_width;
+    }
+
+    inline const std::uint64_t *words() const {
+      return m_words.data();
+    }
+
+    inline std::uint64_t n_words() const {
+      return m_words.size();
+    }
+};
+
+#endif  // __PACKED_ARRAY_HPP_INCLUDED
@@ -0,0 +1,261 @@
+/**
+ * @file    parallel_compute_sa.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __PARALLEL_COMPUTE_SA_HPP_INCLUDED
+#define __PARALLEL_COMPUTE_SA_HPP_INCLUDED
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "parallel_utils.hpp"
+
+
+//=============================================================================
+// Parallel suffix sorting by prefix doubling (Manber-Myers with the
+// Larsson-Sadakane refinement of only re-sorting unsorted groups).
+// Suffixes are first sorted by their first 8 bytes. In every round the
+// group of a suffix is given by the rank of its first h characters and
+// every group of size > 1 is sorted by the rank of the next h characters,
+// after which h is doubled. Groups are independent, so they are spread
+// over threads, and groups larger than the per-thread share are sorted
+// with all threads. Besides sa, it uses n words for ranks, n 64-bit keys,
+// two lists of at most n / 2 groups and the merge buffer of parallel_sort
+// of up to n / 2 words, i.e., 12n bytes on top of a 32-bit sa plus up to
+// 16n for the lists while they grow and 2n for the buffer.
+//
+// The number of rounds is logarithmic in the longest repeat, and on highly
+// repetitive texts the long unsorted groups are sorted again in every
+// round. The suffixes sorted over all rounds are therefore counted, and
+// the sorting is given up once they exceed max_work_factor times the text
+// length, for the caller to fall back to SA-IS.
+//=============================================================================
+namespace parallel_compute_sa_private {
+
+static const std::uint64_t max_work_factor = 4;
+
+//=============================================================================
+// Call f(group, threads, thread_id) for every group in groups. Groups larger
+// than the per-thread share of elements are processed one by one with all
+// threads available to f, the rest are handed out to threads dynamically.
+//=============================================================================
+template<
+  typename group_type,
+  typename function_type>
+void for_each_group(
+    const std::vector<group_type> &groups,
+    const std::uint64_t large_group,
+    const std::uint64_t n_threads,
+    function_type f) {
+  std::vector<std::uint64_t> small;
+  for (std::uint64_t i = 0; i < groups.size(); ++i) {
+    if ((std::uint64_t)groups[i].second -
+        (std::uint64_t)groups[i].first > large_group)
+      f(groups[i], n_threads, (std::uint64_t)0);
+    else small.push_back(i);
+  }
+  std::atomic<std::uint64_t> next(0);
+  parallel_utils::parallel_for(0, n_threads, n_threads,
+      [&](std::uint64_t, std::uint64_t, std::uint64_t thread_id) {
+        static const std::uint64_t chunk = 64;
+        while (true) {
+          const std::uint64_t beg = next.fetch_add(chunk);
+          if (beg >= small.size())
+            break;
+          const std::uint64_t end = std::min(beg + chunk,
+              (std::uint64_t)small.size());
+          for (std::uint64_t i = beg; i < end; ++i)
+            f(groups[small[i]], (std::uint64_t)1, thread_id);
+        }
+      });
+}
+
+//=============================================================================
+// Assign rank (= group head) to all suffixes in sa[beg..end) given their
+// sorting keys, and append all resulting groups of size > 1 to groups.
+//=============================================================================
+template<typename text_offset_type>
+void split_group(
+    const text_offset_type * const sa,
+    const std::uint64_t * const keys,
+    text_offset_type * const rank,
+    const std::uint64_t beg,
+    const std::uint64_t end,
+    std::vector<std::pair<text_offset_type, text_offset_type> > &groups) {
+  typedef std::pair<text_offset_type, text_offset_type> group_type;
+  std::uint64_t head = beg;
+  for (std::uint64_t j = beg; j < end; ++j) {
+    if (j > beg && keys[j] != keys[j - 1]) {
+      if (j - head > 1)
+        groups.push_back(group_type(head, j));
+      head = j;
+    }
+    rank[sa[j]] = head;
+  }
+  if (end - head > 1)
+    groups.push_back(group_type(head, end));
+}
+
+}  // namespace parallel_compute_sa_private
+
+//=============================================================================
+// Compute SA of a given text[0..text_length) using n_threads threads
+// and write to sa[0..text_length). Return false, with sa undefined, if
+// the sorting was given up (see max_work_factor).
+//=============================================================================
+template<
+  typename char_type,
+  typename text_offset_type>
+bool parallel_compute_sa(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    text_offset_type * const sa,
+    const std::uint64_t n_threads) {
+  using namespace parallel_compute_sa_private;
+  typedef std::pair<text_offset_type, text_offset_type> group_type;
+
+  // Handle special case.
+  if (text_length == 0)
+    return true;
+
+  // Allocate arrays.
+  const std::uint64_t n = text_length;
+  text_offset_type * const rank = new text_offset_type[n];
+  std::uint64_t * const keys = new std::uint64_t[n];
+  const std::uint64_t large_group = n / n_threads + 1;
+
+  // Sort suffixes by their first prefix_length characters. The key is
+  // the big-endian packing of those characters, and shorter suffixes
+  // go first among suffixes with equal key, since their key was padded.
+  static const std::uint64_t char_bits = 8 * sizeof(char_type);
+  static const std::uint64_t prefix_length =
+    (char_bits >= 64) ? 1 : 64 / char_bits;
+  parallel_utils::parallel_for(0, n, n_threads,
+      [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+        for (std::uint64_t i = beg; i < end; ++i) {
+          std::uint64_t key = 0;
+          for (std::uint64_t j = 0; j < prefix_length; ++j) {
+            key <<= (char_bits % 64);
+            if (i + j < n)
+              key |= (std::uint64_t)text[i + j];
+          }
+          keys[i] = key;
+          sa[i] = i;
+        }
+      });
+  parallel_utils::parallel_sort(sa, sa + n,
+      [&](const text_offset_type a, const text_offset_type b) {
+        if (keys[a] != keys[b])
+          return keys[a] < keys[b];
+        const std::uint64_t len_a = std::min(prefix_length, n - a);
+        const std::uint64_t len_b = std::min(prefix_length, n - b);
+        return len_a < len_b;
+      }, n_threads);
+
+  // Compute initial ranks. Two suffixes are in the same group iff both
+  // their keys and their lengths (capped at prefix_length) match.
+  std::vector<group_type> groups;
+  {
+    std::uint64_t head = 0;
+    for (std::uint64_t j = 0; j < n; ++j) {
+      if (j > 0) {
+        const std::uint64_t a = sa[j - 1];
+        const std::uint64_t b = sa[j];
+        if (keys[a] != keys[b] ||
+            std::min(prefix_length, n - a) !=
+            std::min(prefix_length, n - b)) {
+          if (j - head > 1)
+            groups.push_back(group_type(head, j));
+          head = j;
+        }
+      }
+      rank[sa[j]] = head;
+    }
+    if (n - head > 1)
+      groups.push_back(group_type(head, n));
+  }
+
+  // Doubling rounds.
+  std::uint64_t work = 0;
+  for (std::uint64_t h = prefix_length; !groups.empty(); h <<= 1) {
+
+    // Give up on texts with too long repeats.
+    for (std::uint64_t i = 0; i < groups.size(); ++i)
+      work += (std::uint64_t)groups[i].second -
+        (std::uint64_t)groups[i].first;
+    if (work > max_work_factor * n) {
+      delete[] rank;
+      delete[] keys;
+      return false;
+    }
+
+    // Sort every unsorted group by the rank of the next h characters
+    // and store the resulting keys. Ranks are only read here.
+    for_each_group(groups, large_group, n_threads,
+        [&](const group_type &g, std::uint64_t threads, std::uint64_t) {
+          const auto key = [&](const text_offset_type a) {
+            return ((std::uint64_t)a + h < n) ?
+              (std::uint64_t)rank[(std::uint64_t)a + h] + 1 :
+              (std::uint64_t)0;
+          };
+          const std::uint64_t beg = g.first;
+          const std::uint64_t end = g.second;
+          parallel_utils::parallel_sort(sa + beg, sa + end,
+              [&](const text_offset_type a, const text_offset_type b) {
+                return key(a) < key(b);
+              }, threads);
+          for (std::uint64_t j = beg; j < end; ++j)
+            keys[j] = key(sa[j]);
+        });
+
+    // Split groups and update ranks. Keys are only read here.
+    std::vector<std::vector<group_type> > new_groups(n_threads);
+    for_each_group(groups, large_group, n_threads,
+        [&](const group_type &g, std::uint64_t, std::uint64_t thread_id) {
+          split_group(sa, keys, rank, (std::uint64_t)g.first,
+              (std::uint64_t)g.second, new_groups[thread_id]);
+        });
+    groups.clear();
+    for (std::uint64_t t = 0; t < n_threads; ++t)
+      groups.insert(groups.end(), new_groups[t].begin(), new_groups[t].end());
+  }
+
+  // Clean up.
+  delete[] rank;
+  delete[] keys;
+  return true;
+}
+
+#endif  // __PARALLEL_COMPUTE_SA_HPP_INCLUDED
@@ -0,0 +1,217 @@
+/**
+ * @file    parallel_utils.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __PARALLEL_UTILS_HPP_INCLUDED
+#define __PARALLEL_UTILS_HPP_INCLUDED
+
+#include <cstdint>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace parallel_utils {
+
+//=============================================================================
+// Split [begin..end) into n_threads contiguous ranges of (almost) equal
+// length and call f(range_beg, range_end, thread_id) for each of them in
+// a separate thread. The call returns after all threads finished.
+//=============================================================================
+template<typename function_type>
+void parallel_for(
+    const std::uint64_t begin,
+    const std::uint64_t end,
+    const std::uint64_t n_threads,
+    function_type f) {
+
+  // Handle special case.
+  if (n_threads <= 1 || end - begin <= 1) {
+    if (begin < end)
+      f(begin, end, (std::uint64_t)0);
+    return;
+  }
+
+  // Spawn threads.
+  const std::uint64_t length = end - begin;
+  const std::uint64_t range_length =
+    (length + n_threads - 1) / n_threads;
+  std::vector<std::thread> threads;
+  for (std::uint64_t t = 0; t < n_threads; ++t) {
+    const std::uint64_t range_beg =
+      begin + std::min(length, t * range_length);
+    const std::uint64_t range_end =
+      begin + std::min(length, (t + 1) * range_length);
+    if (range_beg < range_end)
+      threads.push_back(std::thread(f, range_beg, range_end, t));
+  }
+
+  // Wait for all threads to finish.
+  for (std::uint64_t t = 0; t < threads.size(); ++t)
+    threads[t].join();
+}
+
+//=============================================================================
+// Sort [first..last) using n_threads threads. Each thread sorts one
+// contiguous range, then the sorted ranges are merged pairwise in
+// parallel until a single range remains.
+//=============================================================================
+template<
+  typename iterator_type,
+  typename compare_type>
+void parallel_sort(
+    const iterator_type first,
+    const iterator_type last,
+    const compare_type comp,
+    const std::uint64_t n_threads) {
+  const std::uint64_t length = last - first;
+  if (n_threads <= 1 || length < 2 * n_threads) {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  // Sort ranges.
+  const std::uint64_t range_length =
+    (length + n_threads - 1) / n_threads;
+  std::vector<std::uint64_t> bounds;
+  for (std::uint64_t t = 0; t <= n_threads; ++t)
+    bounds.push_back(std::min(length, t * range_length));
+  parallel_for(0, n_threads, n_threads,
+      [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+        for (std::uint64_t t = beg; t < end; ++t)
+          std::sort(first + bounds[t], first + bounds[t + 1], comp);
+      });
+
+  // Merge ranges.
+  while (bounds.size() > 2) {
+    const std::uint64_t n_merges = (bounds.size() - 1) / 2;
+    parallel_for(0, n_merges, n_merges,
+        [&](std::uint64_t beg, std::uint64_t end, std::uint64_t) {
+          for (std::uint64_t t = beg; t < end; ++t)
+            std::inplace_merge(first + bounds[2 * t],
+                first + bounds[2 * t + 1],
+                first + bounds[2 * t + 2], comp);
+        });
+    std::vector<std::uint64_t> new_bounds;
+    for (std::uint64_t t = 0; t < bounds.size(); t += 2)
+      new_bounds.push_back(bounds[t]);
+    if (new_bounds.back() != bounds.back())
+      new_bounds.push_back(bounds.back());
+    bounds.swap(new_bounds);
+  }
+}
+
+//=============================================================================
+// Call f(task, thread_id) for every task in [0..n_tasks) using n_threads
+// threads with work stealing. Every thread starts with an equal share of
+// the tasks and takes them from the front of its share in chunks of grain
+// tasks. A thread that runs out of work steals the back half of the share
+// of another thread, so uneven task costs do not leave threads idle.
+//=============================================================================
+template<typename function_type>
+void work_stealing_for(
+    const std::uint64_t n_tasks,
+    const std::uint64_t n_threads,
+    const std::uint64_t grain,
+    function_type f) {
+
+  // Handle special case.
+  if (n_threads <= 1) {
+    for (std::uint64_t i = 0; i < n_tasks; ++i)
+      f(i, (std::uint64_t)0);
+    return;
+  }
+
+  // Initialize shares.
+  struct task_share {
+    std::mutex m;
+    std::uint64_t beg;
+    std::uint64_t end;
+  };
+  task_share * const shares = new task_share[n_threads];
+  const std::uint64_t share_length = (n_tasks + n_threads - 1) / n_threads;
+  for (std::uint64_t t = 0; t < n_threads; ++t) {
+    shares[t].beg = std::min(n_tasks, t * share_length);
+    shares[t].end = std::min(n_tasks, (t + 1) * share_length);
+  }
+
+  // Run workers.
+  parallel_for(0, n_threads, n_threads,
+      [&](std::uint64_t, std::uint64_t, std::uint64_t thread_id) {
+        task_share &own = shares[thread_id];
+        while (true) {
+
+          // Take a chunk from the own share.
+          std::uint64_t beg = 0;
+          std::uint64_t end = 0;
+          {
+            std::lock_guard<std::mutex> lk(own.m);
+            beg = own.beg;
+            end = std::min(own.end, own.beg + grain);
+            own.beg = end;
+          }
+          if (beg < end) {
+            for (std::uint64_t i = beg; i < end; ++i)
+              f(i, thread_id);
+            continue;
+          }
+
+          // Steal the back half of the first non-empty share.
+          // The own share is empty, so nobody steals from it meanwhile
+          // and only one lock is ever held at a time.
+          bool stolen = false;
+          for (std::uint64_t j = 1; j < n_threads && !stolen; ++j) {
+            task_share &victim = shares[(thread_id + j) % n_threads];
+            std::lock_guard<std::mutex> lk(victim.m);
+            if (victim.beg < victim.end) {
+              beg = victim.beg + (victim.end - victim.beg) / 2;
+              end = victim.end;
+              victim.end = beg;
+              stolen = true;
+            }
+          }
+          if (!stolen)
+            break;
+          std::lock_guard<std::mutex> lk(own.m);
+          own.beg = beg;
+          own.end = end;
+        }
+      });
+
+  // Clean up.
+  delete[] shares;
+}
+
+}  // namespace parallel_utils
+
+#endif  // __PARALLEL_UTILS_HPP_INCLUDED
@@ -0,0 +1,283 @@
+/**
+ * @file    rmq_fischer_heun.hpp
+ * @section LICENCE
+ *
+ * Copyright (C) 2017-2022
+ * Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef __RMQ_FISCHER_HEUN_HPP_INCLUDED
+#define __RMQ_FISCHER_HEUN_HPP_INCLUDED
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+
+//=============================================================================
+// Constant-time RMQ in the style of Fischer and Heun (CPM 2006). The
+// array is split into microblocks of 8 items. Microblocks with the same
+// Cartesian tree share a table holding the answer to every in-block
+// query, and a microblock only stores the 16-bit id of its tree. Ranges
+// of whole microblocks are answered by a sparse table inside superblocks
+// of 32 microblocks (one byte per entry) and by a sparse table over
+// superblock minima. Every query does a constant number of lookups. The
+// structure takes about 10 bits per item (2 for the tree ids, 5 for the
+// in-superblock tables, the rest for the top level), plus a table of at
+// most 1430 distinct trees. Has the same interface as rmq_tree.
+//=============================================================================
+template<typename ValueType>
+struct rmq_fischer_heun {
+  public:
+    typedef ValueType value_type;
+
+  private:
+    static const std::uint64_t micro_size = 8;
+    static const std::uint64_t micro_per_super = 32;
+    static const std::uint64_t super_size = micro_size * micro_per_super;
+    static const std::uint64_t super_levels = 5;
+
+    const value_type * const m_tab;
+    std::uint64_t m_size;
+    std::uint64_t m_micro_blocks;
+    std::uint64_t m_super_blocks;
+
+    // Cartesian tree id of every microblock and, for every distinct tree,
+    // the in-block offset of the minimum of [i..j] at [id][i][j].
+    std::vector<std::uint16_t> m_tree_id;
+    std::vector<std::uint8_t> m_answers;
+
+    // For superblock s and level k >= 1, the offset (in microblocks,
+    // relative to the superblock) of the microblock holding the minimum
+    // of 2^k microblocks starting at microblock i.
+    std::vector<std::uint8_t> m_in_super;
+
+    // Sparse table over superblocks, m_top[k][s] is the position of the
+    // minimum of superblocks [s..s + 2^k).
+    std::vector<std::vector<std::uint64_t> > m_top;
+
+    inline std::uint64_t min_pos(
+        const std::uint64_t i,
+        const std::uint64_t j) const {
+      return ((std::uint64_t)m_tab[j] < (std::uint64_t)m_tab[i]) ? j : i;
+    }
+
+    // Position of the minimum of [beg..end] within one microblock.
+    inline std::uint64_t in_micro(
+        const std::uint64_t beg,
+        const std::uint64_t end) const {
+      const std::uint64_t block = beg / micro_size;
+      const std::uint64_t block_beg = block * micro_size;
+      return block_beg + m_answers[m_tree_id[block] * micro_size * micro_size +
+        (beg - block_beg) * micro_size + (end - block_beg)];
+    }
+
+    // Position of the minimum of whole microblocks [beg..end] inside
+    // one superblock.
+    inline std::uint64_t in_super(
+        const std::uint64_t beg,
+        const std::uint64_t end) const {
+      const std::uint64_t super = beg / micro_per_super;
+      const std::uint64_t first = super * micro_per_super;
+      std::uint64_t left = beg, right = end;
+      if (beg != end) {
+        const std::uint64_t k = 63 - __builtin_clzll(end - beg + 1);
+        const std::uint64_t base = (super * super_levels + k - 1) * micro_per_super;
+        left = first + m_in_super[base + beg - first];
+        right = first + m_in_super[base + end + 1 - ((std::uint64_t)1 << k) - first];
+      }
+      return min_pos(micro_min(left), micro_min(right));
+    }
+
+    // Position of the minimum of a whole microblock.
+    inline std::uint64_t micro_min(const std::uint64_t block) const {
+      const std::uint64_t block_beg = block * micro_size;
+      const std::uint64_t block_end = std::min(m_size, block_beg + micro_size);
+      return in_micro(block_beg, block_end - 1);
+    }
+
+  public:
+
+    //=========================================================================
+    // Constructor.
+    //=========================================================================
+    rmq_fischer_heun(
+        const value_type * const tab,
+        const std::uint64_t size)
+          : m_tab(tab),
+            m_size(size) {
+      m_micro_blocks = (size + micro_size - 1) / micro_size;
+      m_super_blocks = (m_micro_blocks + micro_per_super - 1) / micro_per_super;
+
+      // Compute Cartesian tree ids. The signature of a tree is the
+      // sequence of stack operations that builds it (a 0 for every pop
+      // and a 1 for every push, so at most 15 bits), and is mapped to a
+      // dense id when first seen, together with the answers for its block.
+      std::vector<std::uint16_t> signature_id(1 << 16,
+          std::numeric_limits<std::uint16_t>::max());
+      m_tree_id.resize(m_micro_blocks);
+      for (std::uint64_t block = 0; block < m_micro_blocks; ++block) {
+        const std::uint64_t block_beg = block * micro_size;
+        const std::uint64_t block_end = std::min(size, block_beg + micro_size);
+        std::uint64_t stack[micro_size];
+        std::uint64_t top = 0;
+        std::uint64_t signature = 0;
+        for (std::uint64_t i = block_beg; i < block_end; ++i) {
+          while (top > 0 && (std::uint64_t)m_tab[stack[top - 1]] >
+              (std::uint64_t)m_tab[i]) {
+            --top;
+            signature <<= 1;
+          }
+          stack[top++] = i;
+          signature = (signature << 1) | 1;
+        }
+        if (signature_id[signature] == std::numeric_limits<std::uint16_t>::max()) {
+          signature_id[signature] = m_answers.size() / (micro_size * micro_size);
+          m_answers.resize(m_answers.size() + micro_size * micro_size, 0);
+          std::uint8_t * const answers = &m_answers[m_answers.size() -
+            micro_size * micro_size];
+          for (std::uint64_t i = block_beg; i < block_end; ++i) {
+            std::uint64_t best = i;
+            for (std::uint64_t j = i; j < block_end; ++j) {
+              best = min_pos(best, j);
+              answers[(i - block_beg) * micro_size + (j - block_beg)] =
+                best - block_beg;
+            }
+          }
+        }
+        m_tree_id[block] = signature_id[signature];
+      }
+
+      // Compute the sparse tables inside superblocks.
+      m_in_super.resize(m_super_blocks * super_levels * micro_per_super, 0);
+      for (std::uint64_t super = 0; super < m_super_blocks; ++super) {
+        const std::uint64_t first = super * micro_per_super;
+        const std::uint64_t last = std::min(m_micro_blocks, first + micro_per_super);
+        for (std::uint64_t k = 1; k <= super_levels; ++k) {
+          const std::uint64_t half = (std::uint64_t)1 << (k - 1);
+          const std::uint64_t base = (super * super_levels + k - 1) * micro_per_super;
+          const std::uint64_t prev = base - micro_per_super;
+          for (std::uint64_t i = first; i + 2 * half <= last; ++i) {
+            const std::uint64_t left = (k == 1) ? i : first + m_in_super[prev + i - first];
+            const std::uint64_t right = (k == 1) ? i + 1 :
+              first + m_in_super[prev + i + half - first];
+            m_in_super[base + i - first] =
+              ((min_pos(micro_min(left), micro_min(right)) == micro_min(left)) ?
+               left : right) - first;
+          }
+        }
+      }
+
+      // Compute the sparse table over superblocks.
+      m_top.push_back(std::vector<std::uint64_t>(m_super_blocks));
+      for (std::uint64_t super = 0; super < m_super_blocks; ++super) {
+        const std::uint64_t first = super * micro_per_super;
+        const std::uint64_t last = std::min(m_micro_blocks, first + micro_per_super);
+        m_top[0][super] = in_super(first, last - 1);
+      }
+      for (std::uint64_t k = 1; ((std::uint64_t)1 << k) <= m_super_blocks; ++k) {
+        const std::uint64_t half = (std::uint64_t)1 << (k - 1);
+        m_top.push_back(std::vector<std::uint64_t>(m_super_blocks - 2 * half + 1));
+        for (std::uint64_t s = 0; s < m_top[k].size(); ++s)
+          m_top[k][s] = min_pos(m_top[k - 1][s], m_top[k - 1][s + half]);
+      }
+    }
+
+    //=========================================================================
+    // Return the size of the data structure in bytes (excluding tab).
+    //=========================================================================
+    inline std::uint64_t size_in_bytes() const {
+      std::uint64_t bytes = m_tree_id.size() * sizeof(std::uint16_t) +
+        m_answers.size() + m_in_super.size();
+      for (std::uint64_t k = 0; k < m_top.size(); ++k)
+        bytes += m_top[k].size() * sizeof(std::uint64_t);
+      return bytes;
+    }
+
+    //=========================================================================
+    // Return position of min in the range [beg..end).
+    //=========================================================================
+    inline std::uint64_t rmq(
+        const std::uint64_t beg,
+        const std::uint64_t end) const {
+
+      // Sanity check.
+      if (beg > m_size || end > m_size) {
+        fprintf(stderr, "\nError: values outside range in rmq_fischer_heun!\n");
+        std::exit(EXIT_FAILURE);
+      }
+
+      // Handle special cases.
+      if (beg >= end)
+        return m_size;
+      const std::uint64_t last = end - 1;
+      const std::uint64_t left_block = beg / micro_size;
+      const std::uint64_t right_block = last / micro_size;
+      if (left_block == right_block)
+        return in_micro(beg, last);
+
+      // Partial microblocks at both ends.
+      std::uint64_t ret = min_pos(
+          in_micro(beg, left_block * micro_size + micro_size - 1),
+          in_micro(right_block * micro_size, last));
+      if (left_block + 1 == right_block)
+        return ret;
+
+      // Whole microblocks in between.
+      const std::uint64_t first_block = left_block + 1;
+      const std::uint64_t last_block = right_block - 1;
+      const std::uint64_t left_super = first_block / micro_per_super;
+      const std::uint64_t right_super = last_block / micro_per_super;
+      if (left_super == right_super)
+        return min_pos(ret, in_super(first_block, last_block));
+      ret = min_pos(ret, in_super(first_block,
+            left_super * micro_per_super + micro_per_super - 1));
+      ret = min_pos(ret, in_super(right_super * micro_per_super, last_block));
+      if (left_super + 1 < right_super) {
+        const std::uint64_t beg_super = left_super + 1;
+        const std::uint64_t k = 63 - __builtin_clzll(right_super - beg_super);
+        ret = min_pos(ret, min_pos(m_top[k][beg_super],
+              m_top[k][right_super - ((std::uint64_t)1 << k)]));
+      }
+      return ret;
+    }
+
+    //=========================================================================
+    // Return the boolean value telling whether there is any item
+    // in the range [beg..end) that is < than given threshold.
+    //=========================================================================
+    inline bool less(
+        const std::uint64_t beg,
+        const std::uint64_t end,
+        const std::uint64_t threshold) const {
+      if (beg >= end)
+        return false;
+      return (std::uint64_t)m_tab[rmq(beg, end)] < threshold;
+    }
+};
+
+#endif  // __RMQ_FISCHER_HEUN_HPP_INCLUDED
@@ -0,0 +1,143 @@
+/**
+ * @file    rmq_sparse_table.hpp
+ * @section LICENCE
+ *
+ * Copyright (C) 2017-2022
+ * Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef __RMQ_SPARSE_TABLE_HPP_INCLUDED
+#define __RMQ_SPARSE_TABLE_HPP_INCLUDED
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+
+//=============================================================================
+// Sparse table RMQ. Level k stores, for every i, the position of the
+// minimum in [i..i + 2^k), as a 32-bit distance from i. A query is
+// answered with two lookups. The data structure uses 4n log n bytes,
+// so it is only practical for moderate n. Has the same interface as
+// rmq_tree.
+//=============================================================================
+template<typename ValueType>
+struct rmq_sparse_table {
+  public:
+    typedef ValueType value_type;
+
+  private:
+    const value_type * const m_tab;
+    std::uint64_t m_size;
+    std::vector<std::vector<std::uint32_t> > m_levels;
+
+    inline std::uint64_t min_pos(
+        const std::uint64_t i,
+        const std::uint64_t j) const {
+      return ((std::uint64_t)m_tab[j] < (std::uint64_t)m_tab[i]) ? j : i;
+    }
+
+  public:
+
+    //=========================================================================
+    // Constructor.
+    //=========================================================================
+    rmq_sparse_table(
+        const value_type * const tab,
+        const std::uint64_t size)
+          : m_tab(tab),
+            m_size(size) {
+      if (size >= ((std::uint64_t)1 << 32) + 1) {
+        fprintf(stderr, "\nError: array too large for rmq_sparse_table!\n");
+        std::exit(EXIT_FAILURE);
+      }
+      for (std::uint64_t k = 1; ((std::uint64_t)1 << k) <= m_size; ++k) {
+        const std::uint64_t half = (std::uint64_t)1 << (k - 1);
+        const std::uint64_t count = m_size - (half << 1) + 1;
+        m_levels.push_back(std::vector<std::uint32_t>(count));
+        std::vector<std::uint32_t> &cur = m_levels.back();
+        for (std::uint64_t i = 0; i < count; ++i) {
+          const std::uint64_t left = (k == 1) ? i : i + m_levels[k - 2][i];
+          const std::uint64_t right = (k == 1) ? i + 1 :
+            i + half + m_levels[k - 2][i + half];
+          cur[i] = min_pos(left, right) - i;
+        }
+      }
+    }
+
+    //=========================================================================
+    // Return the size of the data structure in bytes (excluding tab).
+    //=========================================================================
+    inline std::uint64_t size_in_bytes() const {
+      std::uint64_t bytes = 0;
+      for (std::uint64_t k = 0; k < m_levels.size(); ++k)
+        bytes += m_levels[k].size() * sizeof(std::uint32_t);
+      return bytes;
+    }
+
+    //=========================================================================
+    // Return position of min in the range [beg..end).
+    //=========================================================================
+    inline std::uint64_t rmq(
+        const std::uint64_t beg,
+        const std::uint64_t end) const {
+
+      // Sanity check.
+      if (beg > m_size || end > m_size) {
+        fprintf(stderr, "\nError: values outside range in rmq_sparse_table!\n");
+        std::exit(EXIT_FAILURE);
+      }
+
+      // Handle special cases.
+      if (beg >= end)
+        return m_size;
+      if (beg + 1 == end)
+        return beg;
+
+      // Combine two overlapping ranges of length 2^k.
+      const std::uint64_t k = 63 - __builtin_clzll(end - beg);
+      const std::vector<std::uint32_t> &level = m_levels[k - 1];
+      const std::uint64_t left = beg + level[beg];
+      const std::uint64_t right_beg = end - ((std::uint64_t)1 << k);
+      const std::uint64_t right = right_beg + level[right_beg];
+      return min_pos(left, right);
+    }
+
+    //=========================================================================
+    // Return the boolean value telling whether there is any item
+    // in the range [beg..end) that is < than given threshold.
+    //=========================================================================
+    inline bool less(
+        const std::uint64_t beg,
+        const std::uint64_t end,
+        const std::uint64_t threshold) const {
+      if (beg >= end)
+        return false;
+      return (std::uint64_t)m_tab[rmq(beg, end)] < threshold;
+    }
+};
+
+#endif  // __RMQ_SPARSE_TABLE_HPP_INCLUDED
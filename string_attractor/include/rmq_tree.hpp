@@ -144,7 +144,11 @@ struct rmq_tree {
             m_pos[i] = m_pos[(i << 1) + 1];
           }
         }
-      } else m_data = NULL;
+      } else {
+        m_leaves2 = 0;
+        m_data = NULL;
+        m_pos = NULL;
+      }
     }
 
     //=========================================================================
@@ -254,6 +258,14 @@ struct rmq_tree {
       return false;
     }
 
+    //=========================================================================
+    // Return the size of the data structure in bytes (excluding tab).
+    //=========================================================================
+    inline std::uint64_t size_in_bytes() const {
+      return (m_data != NULL) ?
+        m_leaves2 * 2 * (sizeof(value_type) + sizeof(std::uint64_t)) : 0;
+    }
+
     //=========================================================================
     // Return position of min in the range [beg..end).
     //=========================================================================
@@ -53,6 +53,9 @@ class uint40 {
     uint40(const std::int64_t& a) :
       low(a & 0xFFFFFFFFL), high((a >> 32) & 0xFF) {}
 
+    inline uint40& operator = (const uint40& a) {
+      low = a.low; high = a.high; return *this; }
+
     inline operator uint64_t() const {
       return (((std::uint64_t)high) << 32) | (std::uint64_t)low;  }
     inline bool operator == (const uint40& b) const {
@@ -53,6 +53,9 @@ class uint48 {
     uint48(const std::int64_t& a) :
       low(a & 0xFFFFFFFFL), high((a >> 32) & 0xFFFF) {}
 
+    inline uint48& operator = (const uint48& a) {
+      low = a.low; high = a.high; return *this; }
+
     inline operator uint64_t() const {
       return (((std::uint64_t)high) << 32) | (std::uint64_t)low; }
     inline bool operator == (const uint48& b) const {
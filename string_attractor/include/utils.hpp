@@ -87,6 +87,9 @@ std::string absolute_path(const std::string);
 void empty_page_cache(const std::string);
 #endif
 std::string get_timestamp();
+const void *map_file(const std::string, std::uint64_t &);
+void *create_mapped_file(const std::string, const std::uint64_t);
+void unmap_file(const void * const, const std::uint64_t);
 
 template<typename value_type>
 void write_to_file(
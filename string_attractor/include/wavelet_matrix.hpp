@@ -0,0 +1,154 @@
+/**
+ * @file    wavelet_matrix.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __WAVELET_MATRIX_HPP_INCLUDED
+#define __WAVELET_MATRIX_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+
+
+//=============================================================================
+// Wavelet matrix over a sequence of integers below 2^bits, used as a grid
+// with one point (i, value[i]) per position. report() lists the values in
+// [y_beg..y_end) of the points in the columns [x_beg..x_end) in
+// O((1 + occ) * bits) time. Every level is a bit vector with the number of
+// ones before every word, so the structure takes 2 * size * bits bits.
+//=============================================================================
+class wavelet_matrix {
+  private:
+    std::uint64_t m_size;
+    std::uint64_t m_bits;
+    std::vector<std::vector<std::uint64_t> > m_words;
+    std::vector<std::vector<std::uint64_t> > m_ranks;
+    std::vector<std::uint64_t> m_zeros;
+
+    // Number of ones in the first i bits of the given level.
+    inline std::uint64_t rank1(
+        const std::uint64_t level,
+        const std::uint64_t i) const {
+      const std::uint64_t word = i >> 6;
+      const std::uint64_t bits = i & 63;
+      return m_ranks[level][word] + (bits ? __builtin_popcountll(
+          m_words[level][word] << (64 - bits)) : 0);
+    }
+
+  public:
+    wavelet_matrix()
+      : m_size(0),
+        m_bits(0) {}
+
+    wavelet_matrix(
+        const std::vector<std::uint64_t> &values,
+        const std::uint64_t bits)
+      : m_size(values.size()),
+        m_bits(bits),
+        m_words(bits),
+        m_ranks(bits),
+        m_zeros(bits) {
+      std::vector<std::uint64_t> cur(values), next(m_size);
+      for (std::uint64_t level = 0; level < m_bits; ++level) {
+
+        // Mark the bit of this level and move the zeros to the front.
+        const std::uint64_t shift = m_bits - 1 - level;
+        m_words[level].assign(m_size / 64 + 1, 0);
+        m_ranks[level].assign(m_size / 64 + 1, 0);
+        std::uint64_t zeros = 0;
+        for (std::uint64_t i = 0; i < m_size; ++i)
+          if (((cur[i] >> shift) & 1) == 0)
+            next[zeros++] = cur[i];
+        m_zeros[level] = zeros;
+        for (std::uint64_t i = 0, ones = 0; i < m_size; ++i) {
+          if ((cur[i] >> shift) & 1) {
+            m_words[level][i >> 6] |= 1UL << (i & 63);
+            next[zeros + ones++] = cur[i];
+          }
+        }
+        for (std::uint64_t w = 1; w < m_ranks[level].size(); ++w)
+          m_ranks[level][w] = m_ranks[level][w - 1] +
+            __builtin_popcountll(m_words[level][w - 1]);
+        cur.swap(next);
+      }
+    }
+
+    //=========================================================================
+    // Call report_value(y) for every point (x, y) with x in [x_beg..x_end)
+    // and y in [y_beg..y_end).
+    //=========================================================================
+    template<typename callback_type>
+    void report(
+        const std::uint64_t x_beg,
+        const std::uint64_t x_end,
+        const std::uint64_t y_beg,
+        const std::uint64_t y_end,
+        const callback_type &report_value) const {
+      report(0, x_beg, x_end, 0, y_beg, y_end, report_value);
+    }
+
+    inline std::uint64_t size() const {
+      return m_size;
+    }
+
+  private:
+    // Report the points of the node of the given level whose values start
+    // with prefix and which occupy [beg..end) of the level.
+    template<typename callback_type>
+    void report(
+        const std::uint64_t level,
+        const std::uint64_t beg,
+        const std::uint64_t end,
+        const std::uint64_t prefix,
+        const std::uint64_t y_beg,
+        const std::uint64_t y_end,
+        const callback_type &report_value) const {
+      if (beg >= end)
+        return;
+      const std::uint64_t lo = prefix << (m_bits - level);
+      const std::uint64_t hi = (prefix + 1) << (m_bits - level);
+      if (hi <= y_beg || lo >= y_end)
+        return;
+      if (level == m_bits) {
+        for (std::uint64_t i = beg; i < end; ++i)
+          report_value(prefix);
+        return;
+      }
+      const std::uint64_t ones_beg = rank1(level, beg);
+      const std::uint64_t ones_end = rank1(level, end);
+      report(level + 1, beg - ones_beg, end - ones_end, prefix << 1,
+          y_beg, y_end, report_value);
+      report(level + 1, m_zeros[level] + ones_beg, m_zeros[level] + ones_end,
+          (prefix << 1) | 1, y_beg, y_end, report_value);
+    }
+};
+
+#endif  // __WAVELET_MATRIX_HPP_INCLUDED
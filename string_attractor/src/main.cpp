@@ -33,12 +33,14 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cmath>
 #include <algorithm>
 #include <vector>
 #include <string>
 #include <ctime>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/resource.h>
 
 #include "../include/utils.hpp"
 #include "../include/compute_sa.hpp"
@@ -46,63 +48,238 @@
 #include "../include/uint40.hpp"
 #include "../include/compute_st_att.hpp"
 
-std::uint8_t *generate_string(int alphabets, int length) {
-        std::uint8_t * const text = new std::uint8_t[length];
-        for(int i=0;i<length;i++)
-                text[i] = rand()%alphabets + 'a';
-        for(int i=0;i<length;i++)
-                fprintf(stderr,"%c",text[i]);
-        fprintf(stderr,"\n");
-        return text;
+//=============================================================================
+// Estimate the peak RAM in bytes of computing the SA of a text of length
+// text_length with SA offsets of type sa_offset_type: the text, the SA and,
+// with several threads, the ranks, keys, group lists and merge buffer of
+// the prefix doubling (see parallel_compute_sa).
+//=============================================================================
+template<typename sa_offset_type>
+std::uint64_t sa_sorting_bytes(
+    const std::uint64_t text_length,
+    const std::uint64_t n_threads) {
+  const std::uint64_t n = text_length;
+  const std::uint64_t w = sizeof(sa_offset_type);
+  std::uint64_t bytes = n + w * n;
+  if (n_threads > 1)
+    bytes += (w + 8) * n + 4 * w * n + w * n / 2;
+  return bytes;
+}
+
+//=============================================================================
+// Estimate the peak RAM in bytes of the SA-based construction of the index
+// of a text of length text_length, without the levels of the index. ISA is
+// allocated before sorting. Then LCP and the RMQs over SA and LCP are
+// added, and the PSV (and NSV) array of the LZ77 parsing, or for the other
+// attractors the segment tree of the greedy search and afterwards dist
+// with its RMQ (see sa_index::use_attractor).
+//=============================================================================
+template<typename sa_offset_type>
+std::uint64_t sa_construction_bytes(
+    const std::uint64_t text_length,
+    const std::uint64_t n_threads,
+    const compute_attractor::attractor_type attractor) {
+  const std::uint64_t n = text_length;
+  const std::uint64_t w = sizeof(sa_offset_type);
 
+  // rmq_tree keeps a value and a position for every node of a tree over
+  // blocks of 256 entries.
+  const std::uint64_t rmq = 2 * (n / 256 + 1) * (w + 8);
+  std::uint64_t tree = 1;
+  while (tree < n)
+    tree <<= 1;
+
+  std::uint64_t attractor_bytes = 0;
+  if (attractor == compute_attractor::lz77)
+    attractor_bytes = ((n_threads > 1) ? 2 : 1) * w * n;
+  else if (attractor == compute_attractor::greedy)
+    attractor_bytes = std::max(w * n, 16 * tree);
+  else attractor_bytes = w * n;
+  if (attractor != compute_attractor::lz77)
+    attractor_bytes = std::max(attractor_bytes, w * n + rmq);
+  return std::max(sa_sorting_bytes<sa_offset_type>(n, n_threads) + w * n,
+      n + 3 * w * n + 2 * rmq + attractor_bytes);
+}
+
+//=============================================================================
+// Estimate the peak RAM in bytes of building the index of a text of length
+// text_length from a parsing of n_phrases phrases with the Karp-Rabin
+// engine, without the text and the index itself. Besides the parsing and
+// the attractor positions, every thread holds one level of blocks (see
+// st_att::make_block_lengths for the levels with tau = 2): level 0 has
+// one block per phrase, the others 4. A block takes about 160 bytes with
+// its pointer and its entries in the fingerprint table.
+//=============================================================================
+template<typename pair_type>
+std::uint64_t level_construction_bytes(
+    const std::uint64_t text_length,
+    const std::uint64_t n_phrases,
+    const std::uint64_t n_threads) {
+  static const std::uint64_t block_bytes = 160;
+  std::uint64_t block_len = (text_length + n_phrases - 1) / n_phrases;
+  const std::uint64_t alpha =
+    std::max((std::uint64_t)std::ceil(std::log2(block_len)), 1UL);
+  std::uint64_t n_levels = 0;
+  while (block_len >= 2 * alpha) {
+    block_len = (block_len + 1) / 2;
+    ++n_levels;
+  }
+  const std::uint64_t busy_levels = std::min(n_threads, n_levels);
+  std::uint64_t blocks = 4 * n_phrases * busy_levels;
+  if (busy_levels == n_levels && n_levels > 0)
+    blocks -= 3 * n_phrases;
+  return n_phrases * (sizeof(pair_type) + sizeof(std::int64_t)) +
+    blocks * block_bytes;
 }
 
 //=============================================================================
-// Computes the string atractor parsing of the file given
-// as an argument and write to output file. Then converts it to string attractor
-// and related sturctures
+// Build the index of the text stored in text_filename with SA offsets of
+// type sa_offset_type, report its size (and, if benchmark is set, its
+// query time) and write it to output_filename.
 //=============================================================================
 template<
-  typename char_type = std::uint8_t,
-  typename text_offset_type = std::int64_t>
-void test_st_att(void) 
-  {
-    //const char *z = "CDABCCDABCCA";
-    //std::uint64_t text_length = 12;
-    //char_type *text;
-    //text = generate_string(z, text_length);
-    int alphabet_size = 26, testcases  = 10,text_size = 20, text_length, alphabets,temp;
-    int start ,end;
-    char_type *text;
-
-      text_length = 20000;
-      alphabets = 2;
-      text = generate_string(alphabets, text_length);
-    while(testcases--) {
-      start = rand()%text_length;
-      end = rand()%text_length;
-      if(start > end){
-        temp = end;
-        end = start;
-        start = temp;
-      }
-      st_att<> * st_att_file = new st_att<>(2, text,  text_length);
-      char *x = st_att_file->query(start,end - start + 1);
-      for(int i=start; i<= end; i++)
-      {
-        if(x[i - start]!= text[i])
-        {
-          fprintf(stderr,"Testcase %d failed for query %d %d %d %c %c\n",testcases, start , end , i, x[i - start],text[i]);
-          exit(-1);
-        }
-      }
-      fprintf(stderr,"Testcase %d passed\n",testcases);
-      
+  typename char_type,
+  typename sa_offset_type>
+void build_index(
+    const std::string &text_filename,
+    const std::string &output_filename,
+    const std::uint64_t text_length,
+    const std::uint64_t n_threads,
+    const compute_attractor::attractor_type attractor,
+    bool low_memory,
+    const std::uint64_t ram_budget,
+    const bool benchmark) {
+  typedef st_att<char_type, std::int64_t, sa_offset_type> index_type;
+  typedef typename index_type::pair_type pair_type;
+
+  // Choose the construction that fits the RAM budget. Without a budget
+  // (and without low_memory), the index is built with the SA engine, see
+  // sa_construction_bytes. With one, the LZ77 parsing is computed first,
+  // with the SA in RAM, streamed to disk (the low-memory construction,
+  // which holds the text and the 32- or 40-bit SA, see
+  // compute_lz77::kkp2n_low_memory) or else with a window of the text
+  // (the external-memory construction). The index is then built from the
+  // parsing, whose levels are checked against the budget once the number
+  // of phrases is known, see level_construction_bytes. The other
+  // attractors need the SA engine, whose levels are not covered.
+  bool external = false;
+  bool parse_in_ram = false;
+  if (ram_budget > 0 && attractor != compute_attractor::lz77) {
+    if (sa_construction_bytes<sa_offset_type>(text_length, n_threads,
+          attractor) > ram_budget) {
+      fprintf(stderr, "Error: the RAM budget is too small for the %s "
+          "attractor\n", compute_attractor::name(attractor));
+      std::exit(EXIT_FAILURE);
+    }
+  } else if (ram_budget > 0 && !low_memory) {
+    const std::uint64_t parsing_bytes = text_length *
+      (1 + ((n_threads > 1) ? 3 : 2) * sizeof(sa_offset_type));
+    const std::uint64_t sa_width = (text_length < (1UL << 31)) ? 4 : 5;
+    if (std::max(sa_sorting_bytes<sa_offset_type>(text_length, n_threads),
+          parsing_bytes) <= ram_budget)
+      parse_in_ram = true;
+    else if (text_length * (1 + sa_width) <= ram_budget)
+      low_memory = true;
+    else external = true;
+  }
+
+  // The external-memory construction needs its SA buffer (see
+  // compute_lz77::em_kkp2n) and a window at least as large.
+  static const std::uint64_t sa_buffer = (4UL << 20);
+  if (external && ram_budget < 2 * sa_buffer) {
+    fprintf(stderr, "Error: the RAM budget is too small for the "
+        "external-memory construction (at least %luMiB)\n",
+        (2 * sa_buffer) >> 20);
+    std::exit(EXIT_FAILURE);
+  }
+
+  // In external memory, the text is mapped rather than read.
+  char_type *text = NULL;
+  std::uint64_t mapped_size = 0;
+  if (external)
+    text = (char_type *)utils::map_file(text_filename, mapped_size);
+  else {
+    text = new char_type[text_length];
+    utils::read_from_file(text, text_length, text_filename);
+  }
+
+  // Build the index and write it to the output file.
+  fprintf(stderr, "Construct index... ");
+  long double start = utils::wclock();
+  index_type *index = NULL;
+  if (external || low_memory || parse_in_ram) {
+    std::vector<pair_type> parsing;
+    if (external) {
+      // Leave the SA buffer out of the budget of the window.
+      const std::uint64_t window_length = (ram_budget - sa_buffer) / 9;
+      compute_lz77::em_kkp2n<char_type>(text_filename, text_length,
+          window_length, parsing,
+          output_filename + ".sa." + utils::random_string_hash());
+    } else if (low_memory)
+      compute_lz77::kkp2n_low_memory(text, text_length, parsing,
+          output_filename + ".sa." + utils::random_string_hash());
+    else {
+      sa_offset_type * const sa = new sa_offset_type[text_length];
+      compute_sa(text, text_length, sa, n_threads);
+      if (n_threads > 1)
+        compute_lz77::parallel_kkp2n(text, text_length, sa, parsing,
+            n_threads);
+      else compute_lz77::kkp2n(text, text_length, sa, parsing);
+      delete[] sa;
     }
+    const std::uint64_t level_bytes = (external ? 0 : text_length) +
+      level_construction_bytes<pair_type>(text_length, parsing.size(),
+          n_threads);
+    if (ram_budget > 0 && level_bytes > ram_budget) {
+      fprintf(stderr, "\nError: the RAM budget is too small for the "
+          "levels of the index over %lu phrases\n", parsing.size());
+      std::exit(EXIT_FAILURE);
+    }
+    index = new index_type(2, text, text_length, parsing, n_threads);
+  } else index = new index_type(2, text, text_length, n_threads, false,
+      attractor);
+  fprintf(stderr, "%.2Lfs\n", utils::wclock() - start);
+  struct rusage resources;
+  getrusage(RUSAGE_SELF, &resources);
+  fprintf(stderr, "Peak RAM: %.1LfMiB\n", (long double)resources.ru_maxrss / 1024);
+
+  // Report the attractor size and the index size.
+  fprintf(stderr, "Attractor %s: gamma = %ld, index = %lu bytes\n",
+      compute_attractor::name(attractor), index->attractor_count(),
+      index->size_in_bytes());
 
-    
+  // Time random queries and check their answers against the text.
+  if (benchmark) {
+    static const std::uint64_t n_queries = (1 << 20);
+    std::vector<std::int64_t> positions(n_queries);
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      positions[i] = utils::random_int<std::uint64_t>(0UL, text_length - 1);
+    std::uint64_t checksum = 0;
+    start = utils::wclock();
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      checksum += (char_type)index->query(positions[i]);
+    const long double elapsed = utils::wclock() - start;
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      checksum -= text[positions[i]];
+    if (checksum != 0) {
+      fprintf(stderr, "Error: the index answers wrong queries\n");
+      std::exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "Query: %.1Lfns\n", elapsed * 1e9 / n_queries);
   }
 
+  fprintf(stderr, "Write %s... ", output_filename.c_str());
+  start = utils::wclock();
+  index->write(output_filename);
+  fprintf(stderr, "%.2Lfs\n", utils::wclock() - start);
+
+  // Clean up.
+  delete index;
+  if (external)
+    utils::unmap_file(text, mapped_size);
+  else delete[] text;
+}
+
 //=============================================================================
 // Print usage instructions and exit.
 //=============================================================================
@@ -115,8 +292,25 @@ void usage(
 "Construct the string attractor and data structures parsing of text stored in FILE.\n"
 "\n"
 "Mandatory arguments to long options are mandatory for short options too.\n"
+"  -a, --attractor=TYPE    attractor the index is built on: lz77, bwt\n"
+"                          (BWT run ends), lex (lex-parse) or greedy (local\n"
+"                          search from the smallest of them). Default: lz77\n"
+"  -b, --benchmark         time 2^20 random queries and check their answers\n"
+"                          against the text\n"
 "  -h, --help              display this help and exit\n"
-"  -o, --output=OUTFILE    specify output filename. Default: FILE.st_att\n",
+"  -m, --low-memory        compute the LZ77 parsing with the SA streamed from\n"
+"                          disk and build the index without it (lz77 only)\n"
+"  -o, --output=OUTFILE    specify output filename. Default: FILE.st_att\n"
+"  -r, --ram-budget=MIB    keep the construction within about MIB MiB of\n"
+"                          RAM besides the index: use the SA-based, the\n"
+"                          low-memory or else the external-memory construction\n"
+"                          (text mapped from disk, sliding-window LZ77).\n"
+"                          Fails if the levels of the index do not fit or,\n"
+"                          in external memory, if MIB is below 8. For\n"
+"                          the other attractors only the SA-based one is\n"
+"                          available and the levels are not covered\n"
+"  -t, --threads=NUM       number of threads used for construction.\n"
+"                          Default: 1 (sequential SA-IS)\n",
 
     program_name);
 
@@ -131,25 +325,57 @@ int main(int argc, char **argv) {
 
   // Declare flags.
   static struct option long_options[] = {
+    {"attractor", required_argument, NULL, 'a'},
+    {"benchmark", no_argument,      NULL, 'b'},
     {"help",     no_argument,       NULL, 'h'},
+    {"low-memory", no_argument,     NULL, 'm'},
     {"output",   required_argument, NULL, 'o'},
+    {"ram-budget", required_argument, NULL, 'r'},
+    {"threads",  required_argument, NULL, 't'},
     {NULL,       0,                 NULL, 0}
   };
 
-  // Initialize output filename.
+  // Initialize output filename and number of threads.
   std::string output_filename("");
+  std::int64_t n_threads = 1;
+  compute_attractor::attractor_type attractor = compute_attractor::lz77;
+  bool low_memory = false;
+  bool benchmark = false;
+  std::int64_t ram_budget = 0;
 
   // Parse command-line options.
   int c;
-  while ((c = getopt_long(argc, argv, "ho:",
+  while ((c = getopt_long(argc, argv, "a:bhmo:r:t:",
           long_options, NULL)) != -1) {
     switch(c) {
+      case 'a':
+        if (!compute_attractor::parse(std::string(optarg), attractor)) {
+          fprintf(stderr, "Error: unknown attractor (%s)\n\n", optarg);
+          usage(program_name, EXIT_FAILURE);
+        }
+        break;
+      case 'b':
+        benchmark = true;
+        break;
       case 'h':
         usage(program_name, EXIT_FAILURE);
         break;
+      case 'm':
+        low_memory = true;
+        break;
       case 'o':
         output_filename = std::string(optarg);
         break;
+      case 'r':
+        ram_budget = std::atol(optarg) << 20;
+        if (ram_budget <= 0) {
+          fprintf(stderr, "Error: invalid RAM budget (%s)\n\n", optarg);
+          usage(program_name, EXIT_FAILURE);
+        }
+        break;
+      case 't':
+        n_threads = std::atol(optarg);
+        break;
       default:
         usage(program_name, EXIT_FAILURE);
         break;
@@ -169,6 +395,18 @@ int main(int argc, char **argv) {
     "Only the first will be processed.\n");
   }
 
+  // Check the number of threads.
+  if (n_threads <= 0) {
+    fprintf(stderr, "Error: invalid number of threads\n\n");
+    usage(program_name, EXIT_FAILURE);
+  }
+
+  // The low-memory construction only supports the LZ77 attractor.
+  if (low_memory && attractor != compute_attractor::lz77) {
+    fprintf(stderr, "Error: --low-memory requires the lz77 attractor\n\n");
+    usage(program_name, EXIT_FAILURE);
+  }
+
   // Set default output filename (if not provided).
   if (output_filename.empty())
     output_filename = text_filename + ".st_att";
@@ -210,10 +448,20 @@ int main(int argc, char **argv) {
   // Set types.
   }
 
-  //typedef std::uint8_t char_type;
-  //typedef uint40 text_offset_type;
-
-  // Run the lz77 parsing algorithm.
-  test_st_att<>();
+  typedef std::uint8_t char_type;
 
+  // Read the text.
+  const std::uint64_t text_length =
+    utils::file_size(text_filename) / sizeof(char_type);
+  if (text_length == 0) {
+    fprintf(stderr, "Error: input file (%s) is empty\n",
+        text_filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  // Build the index with the narrowest SA offsets that fit the text.
+  if (text_length < (1UL << 31))
+    build_index<char_type, std::uint32_t>(text_filename, output_filename,
+        text_length, n_threads, attractor, low_memory, ram_budget, benchmark);
+  else build_index<char_type, uint40>(text_filename, output_filename,
+      text_length, n_threads, attractor, low_memory, ram_budget, benchmark);
 }
@@ -0,0 +1,209 @@
+/**
+ * @file    st_att_to_text.cpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "../include/utils.hpp"
+#include "../include/compute_st_att.hpp"
+
+//=============================================================================
+// Print usage instructions and exit.
+//=============================================================================
+void usage(
+    const char * const program_name,
+    const int status) {
+  printf(
+
+"Usage: %s [OPTION]... FILE\n"
+"Decompress the text from the st_att index stored in FILE.\n"
+"\n"
+"Mandatory arguments to long options are mandatory for short options too.\n"
+"  -b, --benchmark         also time a memcpy of the decompressed text\n"
+"  -h, --help              display this help and exit\n"
+"  -o, --output=OUTFILE    specify output filename. Default: FILE with the\n"
+"                          .st_att extension removed, or FILE.txt\n"
+"  -t, --threads=NUM       number of threads used for decompression.\n"
+"                          Default: 1\n",
+
+    program_name);
+
+  std::exit(status);
+}
+
+int main(int argc, char **argv) {
+
+  // Initial setup.
+  const char * const program_name = argv[0];
+
+  // Declare flags.
+  static struct option long_options[] = {
+    {"benchmark", no_argument,       NULL, 'b'},
+    {"help",      no_argument,       NULL, 'h'},
+    {"output",    required_argument, NULL, 'o'},
+    {"threads",   required_argument, NULL, 't'},
+    {NULL,        0,                 NULL, 0}
+  };
+
+  // Initialize output filename and number of threads.
+  std::string output_filename("");
+  std::int64_t n_threads = 1;
+  bool benchmark = false;
+
+  // Parse command-line options.
+  int c;
+  while ((c = getopt_long(argc, argv, "bho:t:",
+          long_options, NULL)) != -1) {
+    switch(c) {
+      case 'b':
+        benchmark = true;
+        break;
+      case 'h':
+        usage(program_name, EXIT_FAILURE);
+        break;
+      case 'o':
+        output_filename = std::string(optarg);
+        break;
+      case 't':
+        n_threads = std::atol(optarg);
+        break;
+      default:
+        usage(program_name, EXIT_FAILURE);
+        break;
+    }
+  }
+
+  // Print error if there is not file.
+  if (optind >= argc) {
+    fprintf(stderr, "Error: FILE not provided\n\n");
+    usage(program_name, EXIT_FAILURE);
+  }
+
+  // Parse the index filename.
+  const std::string index_filename = std::string(argv[optind++]);
+  if (optind < argc) {
+    fprintf(stderr, "Warning: multiple input files provided. "
+    "Only the first will be processed.\n");
+  }
+
+  // Check the number of threads.
+  if (n_threads <= 0) {
+    fprintf(stderr, "Error: invalid number of threads\n\n");
+    usage(program_name, EXIT_FAILURE);
+  }
+
+  // Set default output filename (if not provided).
+  if (output_filename.empty()) {
+    const std::string extension(".st_att");
+    if (index_filename.size() > extension.size() &&
+        index_filename.compare(index_filename.size() - extension.size(),
+          extension.size(), extension) == 0)
+      output_filename = index_filename.substr(0,
+          index_filename.size() - extension.size());
+    else output_filename = index_filename + ".txt";
+  }
+
+  // Check for the existence of the index.
+  if (!utils::file_exists(index_filename)) {
+    fprintf(stderr, "Error: input file (%s) does not exist\n\n",
+        index_filename.c_str());
+    usage(program_name, EXIT_FAILURE);
+  }
+
+  // Check if output file exists.
+  if (utils::file_exists(output_filename)) {
+
+    // Output file exists, should we proceed?
+    char *line = NULL;
+    std::uint64_t buflen = 0;
+    std::int64_t len = 0L;
+
+    // Obtain the answer.
+    do {
+      printf("Output file (%s) exists. Overwrite? [y/n]: ",
+          output_filename.c_str());
+      if ((len = getline(&line, &buflen, stdin)) == -1) {
+        printf("\nError: failed to read answer\n\n");
+        std::fflush(stdout);
+        usage(program_name, EXIT_FAILURE);
+      }
+    } while (len != 2 || (line[0] != 'y' && line[0] != 'n'));
+
+    // If not, then exit.
+    if (line[0] == 'n') {
+      free(line);
+      std::exit(EXIT_FAILURE);
+    }
+
+    // Otherwise, we proceed.
+    free(line);
+  }
+
+  typedef std::uint8_t char_type;
+
+  // Map the index and the output file.
+  mapped_st_att<> index(index_filename);
+  const std::uint64_t text_length = index.text_length();
+  char_type * const text = (char_type *)utils::create_mapped_file(
+      output_filename, text_length * sizeof(char_type));
+
+  // Decompress. Every thread writes its own chunks of the output.
+  fprintf(stderr, "Decompress to %s... ", output_filename.c_str());
+  long double start = utils::wclock();
+  index.decompress(text, n_threads);
+  long double elapsed = utils::wclock() - start;
+  fprintf(stderr, "%.2Lfs (%.3Lf GB/s)\n", elapsed,
+      text_length / std::max(elapsed, 1e-9L) / 1e9L);
+
+  // Compare with copying the text in memory.
+  if (benchmark && text_length > 0) {
+    char_type * const copy = new char_type[text_length];
+    std::memset(copy, 0, text_length);
+    start = utils::wclock();
+    std::memcpy(copy, text, text_length * sizeof(char_type));
+    elapsed = utils::wclock() - start;
+    fprintf(stderr, "memcpy baseline: %.2Lfs (%.3Lf GB/s)\n", elapsed,
+        text_length / std::max(elapsed, 1e-9L) / 1e9L);
+    delete[] copy;
+  }
+
+  // Clean up.
+  utils::unmap_file(text, text_length * sizeof(char_type));
+}
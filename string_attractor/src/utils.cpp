@@ -39,6 +39,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string>
@@ -239,6 +240,66 @@ std::string get_timestamp() {
 }
 #endif
 
+const void *map_file(
+    const std::string filename,
+    std::uint64_t &size) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  size = (std::uint64_t)st.st_size;
+  if (size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void * const ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  close(fd);
+  return ptr;
+}
+
+void *create_mapped_file(
+    const std::string filename,
+    const std::uint64_t size) {
+  const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  if (ftruncate(fd, size) != 0) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  if (size == 0) {
+    close(fd);
+    return NULL;
+  }
+  void * const ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_SHARED, fd, 0);
+  if (ptr == MAP_FAILED) {
+    std::perror(filename.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  close(fd);
+  return ptr;
+}
+
+void unmap_file(
+    const void * const ptr,
+    const std::uint64_t size) {
+  if (ptr != NULL)
+    munmap((void *)ptr, size);
+}
+
 template<>
 std::uint32_t random_int(
     const std::uint32_t p,
@@ -45,13 +45,68 @@
 #include "../include/uint40.hpp"
 #include "../include/compute_st_att.hpp"
 
+//=============================================================================
+// Return the time of 20 rounds of the given queries on the index.
+//=============================================================================
+template<typename index_type, typename char_type, typename text_offset_type>
+double time_queries(
+    index_type *st_att_file,
+    const char_type *text,
+    const text_offset_type *indexes) {
+  double tot_time = 0.0;
+
+  // Run tests. A round is timed as a whole, a clock call per query
+  // would cost more than the query itself.
+  char * const answers = new char[50000];
+  for (std::uint64_t testid = 0; testid < 20; ++testid) {  
+    double t1 = utils::wclock();
+    for(text_offset_type index=0; index< 50000; index++)
+      answers[index] = st_att_file->query(indexes[index]);
+    tot_time+=(utils::wclock()-t1);
+    for(text_offset_type index=0; index< 50000; index++)
+      if(answers[index] != (char)text[indexes[index]])
+        fprintf(stderr,"Alphabet didnt match\n");
+  }
+  delete[] answers;
+  return tot_time;
+}
+
+//=============================================================================
+// Return the time of 20 rounds of the given queries asked as one batch,
+// or interleaved with 16 queries in flight.
+//=============================================================================
+template<typename index_type, typename char_type, typename text_offset_type>
+double time_batch_queries(
+    index_type *st_att_file,
+    const char_type *text,
+    const text_offset_type *indexes,
+    bool interleaved) {
+  double tot_time = 0.0;
+  std::vector<std::int64_t> positions(indexes, indexes + 50000);
+  char_type * const answers = new char_type[50000];
+  for (std::uint64_t testid = 0; testid < 20; ++testid) {
+    double t1 = utils::wclock();
+    if (interleaved)
+      st_att_file->query_interleaved(positions.data(), 50000, answers);
+    else
+      st_att_file->query_batch(positions.data(), 50000, answers);
+    tot_time+=(utils::wclock()-t1);
+    for(text_offset_type index=0; index< 50000; index++)
+      if(answers[index] != text[indexes[index]])
+        fprintf(stderr,"Alphabet didnt match\n");
+  }
+  delete[] answers;
+  return tot_time;
+}
+
 //=============================================================================
 // Run tests for text up to a given length on a given number of cases.
+// Returns the query times of st_att<>, st_att_pow2<2> and of st_att<>
+// answering all queries as one batch and interleaved.
 //=============================================================================
 template<typename char_type, typename text_offset_type>
-double test(
+std::vector<double> test(
     const std::uint64_t max_text_length) {
-  double tot_time = 0.0;
   // Print initial message.
   fprintf(stderr, "TEST, max_length = %lu\n",
       max_text_length);
@@ -61,24 +116,20 @@ double test(
   //Generate text
   for (std::uint64_t i = 0; i < max_text_length; ++i)
     text[i] = 'a' + utils::random_int<std::uint64_t>(0UL, 4);
-  st_att<> * st_att_file = new st_att<>(2, text,  max_text_length);
 
   text_offset_type * const indexes = new text_offset_type[50000];
   for (std::uint64_t i = 0; i < 50000; ++i)
     indexes[i] = utils::random_int<std::uint64_t>(0UL, max_text_length-1);
 
-
-  // Run tests.
-  for (std::uint64_t testid = 0; testid < 20; ++testid) {  
-    for(text_offset_type index=0; index< 50000; index++){
-      double t1 = utils::wclock();
-      char alpha  = st_att_file->query(indexes[index]);
-      tot_time+=(utils::wclock()-t1);
-      if(alpha != text[indexes[index]])
-        fprintf(stderr,"Alphabet didnt match\n");
-    }
-  }
+  std::vector<double> tot_time(4);
+  st_att<> * st_att_file = new st_att<>(2, text,  max_text_length);
+  tot_time[0] = time_queries(st_att_file, text, indexes);
+  tot_time[2] = time_batch_queries(st_att_file, text, indexes, false);
+  tot_time[3] = time_batch_queries(st_att_file, text, indexes, true);
   delete(st_att_file);
+  st_att_pow2<2> * st_att_pow2_file = new st_att_pow2<2>(text, max_text_length);
+  tot_time[1] = time_queries(st_att_pow2_file, text, indexes);
+  delete(st_att_pow2_file);
   delete[] text;
   delete[] indexes;
   return tot_time;
@@ -90,7 +141,7 @@ int main() {
   srand(time(0) + getpid());
 
   static const std::uint64_t text_length_limit = (1 << 24);
-  vector<double> time_to_construct(25,0);
+  vector<vector<double> > time_to_construct(25);
   typedef std::uint8_t char_type;
   typedef long unsigned int text_offset_type;
 
@@ -102,7 +153,10 @@ int main() {
 
   // Print summary.
   for(long int i=0; i<=24;i++)
-    fprintf(stderr,"Query time for string of size %ld is : %f\n",(long)1 << i , time_to_construct[i]);
+    fprintf(stderr,"Query time for string of size %ld is : %f "
+        "(pow2: %f, batch: %f, interleaved: %f)\n",
+        (long)1 << i, time_to_construct[i][0], time_to_construct[i][1],
+        time_to_construct[i][2], time_to_construct[i][3]);
 }
 
 
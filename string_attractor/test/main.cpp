@@ -33,6 +33,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdarg>
 #include <algorithm>
 #include <vector>
 #include <string>
@@ -44,56 +45,474 @@
 #include "../include/compute_lz77.hpp"
 #include "../include/uint40.hpp"
 #include "../include/compute_st_att.hpp"
+#include "test_text.hpp"
 
+typedef std::uint8_t char_type;
+
+//=============================================================================
+// Report a failed check on a text of the given length and exit.
+//=============================================================================
+void fail(const std::uint64_t text_length, const char * const format, ...)
+  __attribute__((format(printf, 2, 3)));
+
+void fail(const std::uint64_t text_length, const char * const format, ...) {
+  fprintf(stderr, "\nError:\n");
+  fprintf(stderr, "  text_length = %lu\n", text_length);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+  std::exit(EXIT_FAILURE);
+}
+
+//=============================================================================
+// Check that query(i) of the given index returns text[i] for every i.
+//=============================================================================
+template<typename index_type>
+void check_query(
+    const index_type &index,
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const char * const name) {
+  for (std::uint64_t i = 0; i < text_length; ++i)
+    if ((char_type)index.query(i) != text[i])
+      fail(text_length, "%s wrong at index %lu", name, i);
+}
+
+//=============================================================================
+// The sequential, parallel, 40-bit and in-place 40-bit suffix arrays.
+//=============================================================================
+void test_sa(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  std::uint64_t * const sa = new std::uint64_t[text_length];
+  compute_sa(text, text_length, sa);
+  std::uint32_t * const sa_par = new std::uint32_t[text_length];
+  compute_sa(text, text_length, sa_par,
+      utils::random_int<std::uint64_t>(2UL, 4UL));
+  if (!std::equal(sa, sa + text_length, sa_par))
+    fail(text_length, "Parallel SA differs");
+  uint40 * const sa40 = new uint40[text_length];
+  compute_sa(text, text_length, sa40);
+  if (!std::equal(sa, sa + text_length, sa40))
+    fail(text_length, "40-bit SA differs");
+  compute_sa_in_place<packed_int<std::int8_t> >(text, text_length, sa40);
+  if (!std::equal(sa, sa + text_length, sa40))
+    fail(text_length, "In-place 40-bit SA differs");
+  delete[] sa40;
+  delete[] sa_par;
+  delete[] sa;
+}
+
+//=============================================================================
+// The parallel, low-memory and external-memory LZ77 parsing against kkp2n.
+//=============================================================================
+void test_lz77(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  std::vector<st_att<>::pair_type> parsing;
+  std::uint64_t * const sa = new std::uint64_t[text_length];
+  compute_sa(text, text_length, sa);
+  compute_lz77::kkp2n(text, text_length, sa, parsing);
+  std::vector<st_att<>::pair_type> parsing_par;
+  compute_lz77::parallel_kkp2n(text, text_length, sa, parsing_par,
+      utils::random_int<std::uint64_t>(1UL, 8UL));
+  delete[] sa;
+  if (parsing_par != parsing)
+    fail(text_length, "Parallel LZ77 parsing differs");
+
+  std::vector<st_att<>::pair_type> parsing_low;
+  const std::string sa_filename = "sa." + utils::random_string_hash();
+  if (utils::random_int<std::uint64_t>(0UL, 1UL))
+    compute_lz77::kkp2n_low_memory(text, text_length, parsing_low,
+        sa_filename);
+  else compute_lz77::kkp2n_low_memory<char_type, std::uint64_t,
+      uint40, uint40>(text, text_length, parsing_low, sa_filename);
+  if (parsing_low != parsing)
+    fail(text_length, "Low-memory LZ77 parsing differs");
+
+  // The external-memory parsing equals the LZ77 parsing if the text
+  // fits in one window, and is a valid parsing otherwise.
+  const std::string text_filename = "text." + utils::random_string_hash();
+  utils::write_to_file(text, text_length, text_filename);
+  const std::uint64_t window_length = utils::random_int<std::uint64_t>(0UL,
+      1UL) ? text_length :
+    utils::random_int<std::uint64_t>(2UL, text_length + 1);
+  std::vector<st_att<>::pair_type> parsing_em;
+  compute_lz77::em_kkp2n<char_type>(text_filename, text_length,
+      window_length, parsing_em, sa_filename);
+  utils::file_delete(text_filename);
+  std::uint64_t pos = 0;
+  for (std::uint64_t i = 0; i < parsing_em.size(); ++i) {
+    const std::uint64_t src = parsing_em[i].first;
+    const std::uint64_t len = parsing_em[i].second;
+    bool valid = (len > 0 || src == text[pos]) && (len == 0 || src < pos);
+    for (std::uint64_t j = 0; j < len && valid; ++j)
+      valid = (pos + j < text_length && text[src + j] == text[pos + j]);
+    if (!valid)
+      fail(text_length, "External-memory LZ77 phrase %lu is wrong", i);
+    pos += std::max(len, (std::uint64_t)1);
+  }
+  if (pos != text_length ||
+      (window_length == text_length && parsing_em != parsing))
+    fail(text_length, "External-memory LZ77 parsing differs");
+}
+
+//=============================================================================
+// Single character queries and range extraction.
+//=============================================================================
+void test_query(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  const st_att<> index(2, (char_type *)text, text_length,
+      utils::random_int<std::uint64_t>(1UL, 3UL));
+  check_query(index, text, text_length, "Query");
+  std::vector<char_type> substring(text_length);
+  for (std::uint64_t q = 0; q < 10; ++q) {
+    const std::uint64_t start =
+      utils::random_int<std::uint64_t>(0UL, text_length - 1);
+    const std::uint64_t len =
+      utils::random_int<std::uint64_t>(0UL, text_length - start);
+    index.query(start, len, substring.data());
+    if (!std::equal(substring.begin(), substring.begin() + len, text + start))
+      fail(text_length, "Wrong extraction of [%lu, %lu)", start, start + len);
+  }
+}
+
+//=============================================================================
+// The other constructions: compact SA offsets, Karp-Rabin fingerprints
+// instead of the SA, power-of-two block lengths and constant-time RMQ.
+//=============================================================================
+void test_construction(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  char_type * const t = (char_type *)text;
+  const st_att<char_type, std::int64_t, uint40> index_40(2, t, text_length);
+  check_query(index_40, text, text_length, "40-bit SA offsets");
+  const st_att<char_type, std::int64_t, std::uint32_t> index_32(2, t,
+      text_length);
+  check_query(index_32, text, text_length, "32-bit SA offsets");
+
+  std::vector<st_att<>::pair_type> parsing;
+  {
+    std::uint64_t * const sa = new std::uint64_t[text_length];
+    compute_sa(text, text_length, sa);
+    compute_lz77::kkp2n(text, text_length, sa, parsing);
+    delete[] sa;
+  }
+  const st_att<> index_kr(2, t, text_length, parsing,
+      utils::random_int<std::uint64_t>(1UL, 3UL));
+  check_query(index_kr, text, text_length, "Karp-Rabin index");
+
+  // Both engines take the leftmost occurrence of every block, so on the
+  // same parsing they must write the same pointers and offset widths.
+  {
+    const std::string filename = "st_att_test." + utils::random_string_hash();
+    std::vector<std::vector<std::uint8_t> > bytes(2);
+    for (std::uint64_t engine = 0; engine < 2; ++engine) {
+      if (engine == 0)
+        st_att<>(2, t, text_length).write(filename);
+      else
+        index_kr.write(filename);
+      bytes[engine].resize(utils::file_size(filename));
+      utils::read_from_file(bytes[engine].data(), bytes[engine].size(),
+          filename);
+      utils::file_delete(filename);
+    }
+    if (bytes[0] != bytes[1])
+      fail(text_length, "SA and Karp-Rabin engines write different indexes");
+  }
+
+  const st_att_pow2<2> index_pow2(t, text_length);
+  check_query(index_pow2, text, text_length, "Power-of-two index");
+  const st_att_pow2<8> index_pow2_kr(t, text_length, parsing);
+  check_query(index_pow2_kr, text, text_length, "Power-of-two index");
+  std::vector<char_type> substring(text_length);
+  index_pow2_kr.query(0, text_length, substring.data());
+  if (!std::equal(substring.begin(), substring.end(), text))
+    fail(text_length, "Power-of-two index extracts a wrong text");
+
+  const st_att<char_type, std::int64_t, std::uint64_t,
+        rmq_fischer_heun<std::uint64_t> > index_fh(2, t, text_length);
+  check_query(index_fh, text, text_length, "Fischer-Heun RMQ index");
+  const st_att<char_type, std::int64_t, std::uint64_t,
+        rmq_sparse_table<std::uint64_t> > index_st(2, t, text_length);
+  check_query(index_st, text, text_length, "Sparse table RMQ index");
+}
+
+//=============================================================================
+// The indexes built on the other attractor providers. The greedy
+// attractor is at most the smallest one it starts from.
+//=============================================================================
+void test_attractors(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  std::int64_t smallest = st_att<>(2, (char_type *)text,
+      text_length).attractor_count();
+  for (std::uint64_t type = compute_attractor::bwt_runs;
+      type <= compute_attractor::greedy; ++type) {
+    const compute_attractor::attractor_type attractor =
+      (compute_attractor::attractor_type)type;
+    const st_att<> index(2, (char_type *)text, text_length,
+        utils::random_int<std::uint64_t>(1UL, 3UL), false, attractor);
+    check_query(index, text, text_length, compute_attractor::name(attractor));
+    if (attractor == compute_attractor::greedy &&
+        index.attractor_count() > smallest)
+      fail(text_length, "Greedy attractor larger than its start");
+    smallest = std::min(smallest, index.attractor_count());
+  }
+}
+
+//=============================================================================
+// Batch queries, sorted and in the given order, interleaved queries and
+// the parallel executor.
 //=============================================================================
-// Run tests for text up to a given length on a given number of cases.
+void test_batch(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  const st_att<> index(2, (char_type *)text, text_length);
+  const std::uint64_t count =
+    utils::random_int<std::uint64_t>(1UL, 3 * text_length);
+  std::vector<std::int64_t> positions(count);
+  for (std::uint64_t q = 0; q < count; ++q)
+    positions[q] = utils::random_int<std::uint64_t>(0UL, text_length - 1);
+  std::vector<char_type> answers(count);
+  for (std::uint64_t kind = 0; kind < 4; ++kind) {
+    std::fill(answers.begin(), answers.end(), 0);
+    if (kind < 2)
+      index.query_batch(positions.data(), count, answers.data(), kind);
+    else if (kind == 2)
+      index.query_interleaved(positions.data(), count, answers.data(),
+          utils::random_int<std::uint64_t>(1UL, 40UL));
+    else index.query_parallel(positions.data(), count, answers.data(),
+        utils::random_int<std::uint64_t>(1UL, 4UL));
+    for (std::uint64_t q = 0; q < count; ++q)
+      if (answers[q] != text[positions[q]])
+        fail(text_length, "%s query wrong at index %ld",
+            (kind == 0) ? "Batch" : (kind == 1) ? "Sorted batch" :
+            (kind == 2) ? "Interleaved" : "Parallel", positions[q]);
+  }
+}
+
+//=============================================================================
+// The iterators in both directions and a random walk back and forth.
+//=============================================================================
+void test_iterators(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  const st_att<> index(2, (char_type *)text, text_length);
+  std::uint64_t i = 0;
+  for (st_att<>::const_iterator it = index.begin(); it != index.end();
+      ++it, ++i)
+    if (*it != text[i])
+      fail(text_length, "Iterator wrong at index %lu", i);
+  for (st_att<>::const_reverse_iterator it = index.rbegin();
+      it != index.rend(); ++it)
+    if (*it != text[--i])
+      fail(text_length, "Reverse iterator wrong at index %lu", i);
+
+  st_att<>::const_iterator it = index.end();
+  i = text_length;
+  for (std::uint64_t step = 0; step < 2 * text_length; ++step) {
+    if (i == text_length || (i > 0 &&
+          utils::random_int<std::uint64_t>(0UL, 2UL) == 0)) {
+      --it;
+      --i;
+    } else {
+      ++it;
+      ++i;
+    }
+    if (i < text_length && *it != text[i])
+      fail(text_length, "Iterator walk wrong at index %lu", i);
+  }
+}
+
+//=============================================================================
+// Karp-Rabin fingerprints of substrings and LCE queries.
+//=============================================================================
+void test_fingerprints(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t period) {
+  st_att<> index(2, (char_type *)text, text_length);
+  const std::uint64_t base = karp_rabin::random_base();
+  index.make_fingerprints(text, base,
+      utils::random_int<std::uint64_t>(1UL, 3UL));
+  for (std::uint64_t q = 0; q < 20; ++q) {
+    std::uint64_t i = utils::random_int<std::uint64_t>(0UL, text_length);
+    std::uint64_t j = utils::random_int<std::uint64_t>(0UL, text_length);
+    if (i > j)
+      std::swap(i, j);
+    if (index.fingerprint(i, j) !=
+        karp_rabin::fingerprint(text + i, j - i, base))
+      fail(text_length, "Wrong fingerprint of [%lu, %lu)", i, j);
+
+    // Pick j at a period of the text to get long extensions too.
+    i = utils::random_int<std::uint64_t>(0UL, text_length - 1);
+    j = (q % 2 && i + period < text_length) ? i + period :
+      utils::random_int<std::uint64_t>(0UL, text_length - 1);
+    std::uint64_t lce = 0;
+    while (std::max(i, j) + lce < text_length && text[i + lce] == text[j + lce])
+      ++lce;
+    if ((std::uint64_t)index.lce(i, j) != lce)
+      fail(text_length, "Wrong LCE of %lu and %lu", i, j);
+  }
+}
+
+//=============================================================================
+// Rank and select of one of the counted characters.
+//=============================================================================
+void test_rank_select(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  st_att<> index(2, (char_type *)text, text_length);
+  std::vector<char_type> chars;
+  chars.push_back('a');
+  chars.push_back('c');
+  index.make_char_counts(text, chars,
+      utils::random_int<std::uint64_t>(1UL, 3UL));
+  const char_type c = chars[utils::random_int<std::uint64_t>(0UL, 1UL)];
+  std::vector<std::uint64_t> occ;
+  for (std::uint64_t i = 0; i < text_length; ++i)
+    if (text[i] == c)
+      occ.push_back(i);
+  for (std::uint64_t q = 0; q < 20; ++q) {
+    const std::uint64_t i = utils::random_int<std::uint64_t>(0UL, text_length);
+    const std::uint64_t r = std::lower_bound(occ.begin(), occ.end(), i) -
+      occ.begin();
+    if ((std::uint64_t)index.rank(c, i) != r)
+      fail(text_length, "Wrong rank of %c at %lu", c, i);
+    const std::uint64_t k = utils::random_int<std::uint64_t>(0UL, occ.size());
+    const std::uint64_t p = (k < occ.size()) ? occ[k] : text_length;
+    if ((std::uint64_t)index.select(c, k) != p)
+      fail(text_length, "Wrong select of the %lu-th %c", k, c);
+  }
+}
+
+//=============================================================================
+// Count and locate of patterns from the text and of random ones.
+//=============================================================================
+void test_count_locate(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  st_att<> index(2, (char_type *)text, text_length);
+  index.make_search_index(text, utils::random_int<std::uint64_t>(1UL, 3UL));
+  for (std::uint64_t q = 0; q < 10; ++q) {
+    // Take the pattern from the text or, sometimes, make a random one.
+    const std::uint64_t m = utils::random_int<std::uint64_t>(1UL,
+        std::min(text_length, (std::uint64_t)20));
+    const std::uint64_t start = utils::random_int<std::uint64_t>(0UL,
+        text_length - m);
+    std::vector<char_type> pattern(text + start, text + start + m);
+    if (q % 5 == 4)
+      for (std::uint64_t i = 0; i < m; ++i)
+        pattern[i] = 'a' + utils::random_int<std::uint64_t>(0UL, 4);
+    std::vector<std::int64_t> occ;
+    for (std::uint64_t i = 0; i + m <= text_length; ++i)
+      if (std::equal(pattern.begin(), pattern.end(), text + i))
+        occ.push_back(i);
+    std::vector<std::int64_t> found = index.locate(pattern.data(), m);
+    std::sort(found.begin(), found.end());
+    if (found != occ || index.count(pattern.data(), m) != occ.size())
+      fail(text_length, "Wrong occurrences of the pattern at %lu of length %lu",
+          start, m);
+  }
+}
+
+//=============================================================================
+// The index written to disk and mapped back with mapped_st_att.
+//=============================================================================
+void test_mapped(
+    const char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t) {
+  const std::string filename = "st_att_test." + utils::random_string_hash();
+  st_att<>(2, (char_type *)text, text_length).write(filename);
+  {
+    const mapped_st_att<> mapped(filename);
+    check_query(mapped, text, text_length, "Mapped index");
+    std::vector<char_type> substring(text_length);
+    std::vector<std::int64_t> positions(text_length);
+    for (std::uint64_t q = 0; q < text_length; ++q)
+      positions[q] = text_length - 1 - q;
+    mapped.query_batch(positions.data(), text_length, substring.data());
+    if (!std::equal(substring.begin(), substring.end(),
+          std::reverse_iterator<const char_type *>(text + text_length)))
+      fail(text_length, "Mapped index batch query wrong");
+    std::uint64_t next = 0;
+    mapped.query_stream(
+        [&](std::uint64_t &position) {
+          position = next;
+          return next++ < text_length;
+        },
+        [&](std::uint64_t i, char_type c) { substring[i] = c; }, 4);
+    if (!std::equal(substring.begin(), substring.end(), text))
+      fail(text_length, "Mapped index query stream wrong");
+    if (!std::equal(mapped.rbegin(), mapped.rend(),
+          std::reverse_iterator<const char_type *>(text + text_length)))
+      fail(text_length, "Mapped index reverse iterator wrong");
+    std::fill(substring.begin(), substring.end(), 0);
+    mapped.decompress(substring.data(),
+        utils::random_int<std::uint64_t>(1UL, 4UL));
+    if (!std::equal(substring.begin(), substring.end(), text))
+      fail(text_length, "Mapped index decompresses a wrong text");
+    mapped.query(0, text_length, substring.data());
+    if (!std::equal(substring.begin(), substring.end(), text))
+      fail(text_length, "Mapped index extracts a wrong text");
+  }
+  utils::file_delete(filename);
+}
+
+//=============================================================================
+// Run check on texts of length up to 1, 2, 4, ..., text_length_limit, on
+// testcases texts of each. Every other text is a mutated repetition of its
+// prefix of length period, see test_text::generate, the others are random.
 //=============================================================================
-template<typename char_type, typename text_offset_type>
 void test(
-    const std::uint64_t max_text_length,
+    const char * const name,
+    void (*check)(const char_type *, std::uint64_t, std::uint64_t),
+    const std::uint64_t text_length_limit,
     const std::uint64_t testcases) {
 
-  // Print initial message.
-  fprintf(stderr, "TEST, max_length = %lu, testcases = %lu\n",
-      max_text_length, testcases);
-
-  
-  // Allocate text and SA.
-  char_type * const text = new char_type[max_text_length];
-
-  // Run tests.
-  for (std::uint64_t testid = 0; testid < testcases; ++testid) {
-
-    // Print progress message.
-    if (testid % 10 == 0)
-      fprintf(stderr, "%.2Lf%%\r", (100.L * testid) / testcases);
-
-    // Generate the text.
-    const std::uint64_t text_length =
-      utils::random_int<std::uint64_t>(
-          (std::uint64_t)1,
-          (std::uint64_t)max_text_length);
-    for (std::uint64_t i = 0; i < text_length; ++i)
-      text[i] = 'a' + utils::random_int<std::uint64_t>(0UL, 4);
-    
-    /* Compute string attractor structure*/
-    st_att<> * st_att_file = new st_att<>(2, text,  text_length);
-    for(text_offset_type index=0; index< text_length; index++){
-      char alpha = st_att_file->query(index);
-      if(text[index]!=alpha){
-        fprintf(stderr, "\nError:\n");
-        fprintf(stderr, "  text_length = %lu\n", text_length);
-        fprintf(stderr, "Wrong at index %lu\n",index);
-        fprintf(stderr, "Actual alphabet %c Predicted Alphabet %c\n",text[index], alpha);
-        fprintf(stderr, "  text = ");
-        for (std::uint64_t i = 0; i < text_length; ++i)
-          fprintf(stderr, "%c", text[index]);
-        fprintf(stderr, "\n");
-        
-      std::exit(EXIT_FAILURE);
-      }
+  // Allocate text.
+  char_type * const text = new char_type[text_length_limit];
+
+  for (std::uint64_t max_text_length = 1;
+      max_text_length <= text_length_limit; max_text_length *= 2) {
+
+    // Print initial message.
+    fprintf(stderr, "TEST %s, max_length = %lu, testcases = %lu\n",
+        name, max_text_length, testcases);
+
+    // Run tests.
+    for (std::uint64_t testid = 0; testid < testcases; ++testid) {
+
+      // Print progress message.
+      if (testid % 10 == 0)
+        fprintf(stderr, "%.2Lf%%\r", (100.L * testid) / testcases);
+
+      // Generate the text.
+      const std::uint64_t text_length =
+        utils::random_int<std::uint64_t>(
+            (std::uint64_t)1,
+            (std::uint64_t)max_text_length);
+      const std::uint64_t period = (testid % 2) ?
+        utils::random_int<std::uint64_t>(1UL, text_length) : text_length;
+      test_text::generate(text, text_length, period, 50, []() {
+            return 'a' + utils::random_int<std::uint64_t>(0UL, 4);
+          });
+      check(text, text_length, period);
     }
-    delete(st_att_file);
   }
   delete[] text;
 }
@@ -103,19 +522,20 @@ int main() {
   // Init random number generator.
   srand(time(0) + getpid());
 
-  static const std::uint64_t text_length_limit = (1 << 20);
-  static const std::uint64_t n_tests = 1000;
-
-  typedef std::uint8_t char_type;
-  typedef long unsigned int text_offset_type;
-
-  // Run tests.
-  for (std::uint64_t max_text_length = 1;
-      max_text_length <= text_length_limit; max_text_length *= 2)
-    test<char_type, text_offset_type>(max_text_length, n_tests);
+  // Run tests. The plain queries get the longest texts, the constructions
+  // that need all of them, as well as the brute-force checks, shorter ones.
+  test("query", test_query, 1 << 20, 1000);
+  test("sa", test_sa, 1 << 16, 200);
+  test("lz77", test_lz77, 1 << 16, 200);
+  test("construction", test_construction, 1 << 14, 100);
+  test("attractors", test_attractors, 1 << 12, 100);
+  test("batch", test_batch, 1 << 14, 100);
+  test("iterators", test_iterators, 1 << 14, 100);
+  test("fingerprints", test_fingerprints, 1 << 14, 100);
+  test("rank_select", test_rank_select, 1 << 14, 100);
+  test("count_locate", test_count_locate, 1 << 12, 100);
+  test("mapped", test_mapped, 1 << 14, 100);
 
   // Print summary.
   fprintf(stderr, "All tests passed.\n");
 }
-
-
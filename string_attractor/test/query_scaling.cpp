@@ -0,0 +1,111 @@
+/**
+ * @file    query_scaling.cpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <thread>
+#include <unistd.h>
+
+#include "../include/utils.hpp"
+#include "../include/compute_sa.hpp"
+#include "../include/compute_st_att.hpp"
+#include "test_text.hpp"
+
+//=============================================================================
+// Answer the queries with st_att::query_parallel on 1, 2, 4, ... up to
+// max_threads threads and report the throughput and its scaling.
+//=============================================================================
+int main(int argc, char **argv) {
+
+  // Init random number generator.
+  srand(time(0) + getpid());
+
+  typedef std::uint8_t char_type;
+  static const std::uint64_t n_queries = (1 << 24);
+  static const std::uint64_t n_rounds = 5;
+
+  // Read the text from the given file or generate a random one.
+  std::uint64_t text_length = (1 << 24);
+  char_type * const text = test_text::read_or_generate<char_type>(argc, argv,
+      text_length, text_length, 1, []() {
+        return 'a' + utils::random_int<std::uint64_t>(0UL, 4);
+      });
+  std::uint64_t max_threads = std::thread::hardware_concurrency();
+  if (argc > 2)
+    max_threads = std::atol(argv[2]);
+  max_threads = std::max(max_threads, (std::uint64_t)1);
+  fprintf(stderr, "Text length = %lu, max threads = %lu\n",
+      text_length, max_threads);
+
+  // Build the index and generate the queries.
+  double t1 = utils::wclock();
+  st_att<> * const index = new st_att<>(2, text, text_length, max_threads);
+  fprintf(stderr, "Construction %.2Lfs\n", (long double)(utils::wclock() - t1));
+  std::vector<std::int64_t> positions(n_queries);
+  for (std::uint64_t i = 0; i < n_queries; ++i)
+    positions[i] = utils::random_int<std::uint64_t>(0UL, text_length - 1);
+  std::vector<char_type> answers(n_queries);
+
+  // Run the queries.
+  double base_throughput = 0.0;
+  for (std::uint64_t n_threads = 1; ; n_threads = std::min(2 * n_threads,
+        max_threads)) {
+    std::fill(answers.begin(), answers.end(), 0);
+    t1 = utils::wclock();
+    for (std::uint64_t round = 0; round < n_rounds; ++round)
+      index->query_parallel(positions.data(), n_queries, answers.data(),
+          n_threads);
+    const double elapsed = utils::wclock() - t1;
+    for (std::uint64_t i = 0; i < n_queries; ++i) {
+      if (answers[i] != text[positions[i]]) {
+        fprintf(stderr, "\nError: wrong answer for position %ld\n",
+            positions[i]);
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    const double throughput = (n_rounds * n_queries) / elapsed / 1e6;
+    if (n_threads == 1)
+      base_throughput = throughput;
+    fprintf(stderr, "  threads = %2lu: %.2f M queries/s, speedup %.2f\n",
+        n_threads, throughput, throughput / base_throughput);
+    if (n_threads == max_threads)
+      break;
+  }
+
+  delete index;
+  delete[] text;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file    rank_select.cpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <unistd.h>
+
+#include "../include/utils.hpp"
+#include "../include/compute_sa.hpp"
+#include "../include/compute_st_att.hpp"
+#include "test_text.hpp"
+
+//=============================================================================
+// Time st_att::rank and st_att::select of the newline character, as used
+// to map line numbers to text positions, against counting the newlines of
+// the decompressed text.
+//=============================================================================
+int main(int argc, char **argv) {
+
+  // Init random number generator.
+  srand(time(0) + getpid());
+
+  typedef std::uint8_t char_type;
+  static const std::uint64_t n_queries = (1 << 20);
+
+  // Read the text from the given file or generate a repetitive one with
+  // lines of up to 100 characters.
+  std::uint64_t text_length = (1 << 24);
+  char_type * const text = test_text::read_or_generate<char_type>(argc, argv,
+      text_length, 1 << 16, 1000, []() {
+        return utils::random_int<std::uint64_t>(0UL, 99) ? 'a' +
+          utils::random_int<std::uint64_t>(0UL, 25) : '\n';
+      });
+  fprintf(stderr, "Text length = %lu\n", text_length);
+
+  // Build the index and the counts of the newline.
+  double t1 = utils::wclock();
+  st_att<> * const index = new st_att<>(2, text, text_length);
+  fprintf(stderr, "Construction %.2Lfs\n", (long double)(utils::wclock() - t1));
+  t1 = utils::wclock();
+  index->make_char_counts(text, std::vector<char_type>(1, '\n'));
+  fprintf(stderr, "Counts %.2Lfs\n", (long double)(utils::wclock() - t1));
+  std::vector<std::uint64_t> lines;
+  for (std::uint64_t i = 0; i < text_length; ++i)
+    if (text[i] == '\n')
+      lines.push_back(i);
+  fprintf(stderr, "Lines = %lu\n", lines.size() + 1);
+
+  // Count the newlines of the decompressed text.
+  char_type * const buffer = new char_type[text_length];
+  t1 = utils::wclock();
+  index->query(0, text_length, buffer);
+  const std::uint64_t count = std::count(buffer, buffer + text_length, '\n');
+  const double scan_time = utils::wclock() - t1;
+  if (count != lines.size()) {
+    fprintf(stderr, "\nError: wrong count of the scan\n");
+    std::exit(EXIT_FAILURE);
+  }
+  fprintf(stderr, "  scan:   %.2fms per query\n", scan_time * 1e3);
+
+  // Time rank.
+  std::vector<std::int64_t> positions(n_queries);
+  for (std::uint64_t i = 0; i < n_queries; ++i)
+    positions[i] = utils::random_int<std::uint64_t>(0UL, text_length);
+  std::uint64_t checksum = 0;
+  t1 = utils::wclock();
+  for (std::uint64_t i = 0; i < n_queries; ++i)
+    checksum += index->rank('\n', positions[i]);
+  const double rank_time = utils::wclock() - t1;
+  for (std::uint64_t i = 0; i < n_queries; ++i)
+    checksum -= std::lower_bound(lines.begin(), lines.end(),
+        (std::uint64_t)positions[i]) - lines.begin();
+  if (checksum != 0) {
+    fprintf(stderr, "\nError: wrong rank\n");
+    std::exit(EXIT_FAILURE);
+  }
+  fprintf(stderr, "  rank:   %.1fns per query\n", rank_time * 1e9 / n_queries);
+
+  // Time select.
+  if (!lines.empty()) {
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      positions[i] = utils::random_int<std::uint64_t>(0UL, lines.size() - 1);
+    t1 = utils::wclock();
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      checksum += index->select('\n', positions[i]);
+    const double select_time = utils::wclock() - t1;
+    for (std::uint64_t i = 0; i < n_queries; ++i)
+      checksum -= lines[positions[i]];
+    if (checksum != 0) {
+      fprintf(stderr, "\nError: wrong select\n");
+      std::exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "  select: %.1fns per query\n",
+        select_time * 1e9 / n_queries);
+  }
+
+  delete[] buffer;
+  delete index;
+  delete[] text;
+}
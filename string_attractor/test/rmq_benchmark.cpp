@@ -0,0 +1,184 @@
+/**
+ * @file    rmq_benchmark.cpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <unistd.h>
+
+#include "../include/utils.hpp"
+#include "../include/compute_sa.hpp"
+#include "../include/rmq_tree.hpp"
+#include "../include/rmq_sparse_table.hpp"
+#include "../include/rmq_fischer_heun.hpp"
+#include "test_text.hpp"
+
+//=============================================================================
+// Time queries on the given RMQ backend for the ranges in [beg, end) and
+// check the answers against the expected positions.
+//=============================================================================
+template<typename rmq_type, typename value_type>
+void benchmark(
+    const char * const name,
+    const value_type * const tab,
+    const std::uint64_t length,
+    const std::vector<std::uint64_t> &beg,
+    const std::vector<std::uint64_t> &end,
+    const std::vector<std::uint64_t> &expected) {
+
+  // Construct the data structure.
+  double t1 = utils::wclock();
+  rmq_type *rmq = new rmq_type(tab, length);
+  const double construction_time = utils::wclock() - t1;
+
+  // Run the queries.
+  std::uint64_t checksum = 0;
+  t1 = utils::wclock();
+  for (std::uint64_t i = 0; i < beg.size(); ++i)
+    checksum += rmq->rmq(beg[i], end[i]);
+  const double query_time = utils::wclock() - t1;
+
+  // Check the answers (compare values, ties may be broken differently).
+  for (std::uint64_t i = 0; i < beg.size(); ++i) {
+    const std::uint64_t pos = rmq->rmq(beg[i], end[i]);
+    if (pos < beg[i] || pos >= end[i] || tab[pos] != tab[expected[i]]) {
+      fprintf(stderr, "\nError: %s wrong for range [%lu..%lu)\n",
+          name, beg[i], end[i]);
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  fprintf(stderr, "  %-18s construction %.3Lfs, %.2Lf bits/item, "
+      "%.1Lfns/query (checksum %lu)\n", name, (long double)construction_time,
+      (8.L * rmq->size_in_bytes()) / std::max(length, (std::uint64_t)1),
+      (1e9L * query_time) / std::max(beg.size(), (std::uint64_t)1), checksum);
+  delete rmq;
+}
+
+//=============================================================================
+// Compare all RMQ backends on the array tab for ranges of given length.
+//=============================================================================
+template<typename value_type>
+void benchmark_all(
+    const value_type * const tab,
+    const std::uint64_t length,
+    const std::uint64_t range_length,
+    const std::uint64_t n_queries) {
+
+  fprintf(stderr, " range length = %lu\n", range_length);
+
+  // Generate the queries and compute the answers with the tree.
+  std::vector<std::uint64_t> beg(n_queries);
+  std::vector<std::uint64_t> end(n_queries);
+  std::vector<std::uint64_t> expected(n_queries);
+  {
+    rmq_tree<value_type> reference(tab, length);
+    for (std::uint64_t i = 0; i < n_queries; ++i) {
+      beg[i] = utils::random_int<std::uint64_t>(0UL, length - range_length);
+      end[i] = beg[i] + range_length;
+      expected[i] = reference.rmq(beg[i], end[i]);
+    }
+
+    // Check the reference against brute force on short ranges.
+    for (std::uint64_t i = 0; i < n_queries && range_length <= 256; ++i) {
+      const value_type *min = std::min_element(tab + beg[i], tab + end[i]);
+      if (*min != tab[expected[i]]) {
+        fprintf(stderr, "\nError: rmq_tree wrong for range [%lu..%lu)\n",
+            beg[i], end[i]);
+        std::exit(EXIT_FAILURE);
+      }
+    }
+  }
+
+  benchmark<rmq_tree<value_type> >("rmq_tree",
+      tab, length, beg, end, expected);
+  benchmark<rmq_sparse_table<value_type> >("rmq_sparse_table",
+      tab, length, beg, end, expected);
+  benchmark<rmq_fischer_heun<value_type> >("rmq_fischer_heun",
+      tab, length, beg, end, expected);
+}
+
+int main(int argc, char **argv) {
+
+  // Init random number generator.
+  srand(time(0) + getpid());
+
+  typedef std::uint8_t char_type;
+  typedef std::uint64_t sa_offset_type;
+  static const std::uint64_t n_queries = 1000000;
+
+  // Read the text from the given file or generate a random one.
+  std::uint64_t text_length = (1 << 24);
+  char_type * const text = test_text::read_or_generate<char_type>(argc, argv,
+      text_length, text_length, 1, []() {
+        return 'a' + utils::random_int<std::uint64_t>(0UL, 4);
+      });
+  fprintf(stderr, "Text length = %lu\n", text_length);
+
+  // Compute SA and LCP array (Kasai et al.), the arrays
+  // the index queries during construction.
+  sa_offset_type * const sa = new sa_offset_type[text_length];
+  sa_offset_type * const lcp = new sa_offset_type[text_length];
+  {
+    compute_sa(text, text_length, sa);
+    sa_offset_type * const isa = new sa_offset_type[text_length];
+    for (std::uint64_t i = 0; i < text_length; ++i)
+      isa[sa[i]] = i;
+    std::uint64_t h = 0;
+    for (std::uint64_t i = 0; i < text_length; ++i) {
+      if (isa[i] == 0) { lcp[0] = 0; h = 0; continue; }
+      const std::uint64_t j = sa[isa[i] - 1];
+      while (i + h < text_length && j + h < text_length &&
+          text[i + h] == text[j + h]) ++h;
+      lcp[isa[i]] = h;
+      if (h > 0) --h;
+    }
+    delete[] isa;
+  }
+
+  // Run the benchmarks.
+  for (std::uint64_t range_length = 1; range_length <= text_length;
+      range_length *= 16) {
+    fprintf(stderr, "SA,");
+    benchmark_all(sa, text_length, range_length, n_queries);
+    fprintf(stderr, "LCP,");
+    benchmark_all(lcp, text_length, range_length, n_queries);
+  }
+
+  delete[] sa;
+  delete[] lcp;
+  delete[] text;
+}
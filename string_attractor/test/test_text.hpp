@@ -0,0 +1,102 @@
+/**
+ * @file    test_text.hpp
+ * @section LICENCE
+ *
+ * This file is part of Lazy-AVLG v0.1.0
+ * See: https://github.com/dominikkempa/lz77-to-slp
+ *
+ * Copyright (C) 2021
+ *   Dominik Kempa <dominik.kempa (at) gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ **/
+
+
+#ifndef __TEST_TEXT_HPP_INCLUDED
+#define __TEST_TEXT_HPP_INCLUDED
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+#include "../include/utils.hpp"
+
+namespace test_text {
+
+//=============================================================================
+// Fill text[0..text_length) with a mutated repetition of its prefix of
+// length period. Characters of the prefix and, on average, one in
+// mutation_rate of the others are drawn with random_char(), the rest
+// copy the character period positions before. With period == text_length
+// the text is random.
+//=============================================================================
+template<
+  typename char_type,
+  typename char_generator_type>
+void generate(
+    char_type * const text,
+    const std::uint64_t text_length,
+    const std::uint64_t period,
+    const std::uint64_t mutation_rate,
+    char_generator_type random_char) {
+  for (std::uint64_t i = 0; i < text_length; ++i) {
+    if (i < period ||
+        utils::random_int<std::uint64_t>(0UL, mutation_rate - 1) == 0)
+      text[i] = random_char();
+    else text[i] = text[i - period];
+  }
+}
+
+//=============================================================================
+// Text of a benchmark: read from the file argv[1] if given, otherwise
+// generated with generate() with the given length and parameters. Exits
+// if the text is empty.
+//=============================================================================
+template<
+  typename char_type,
+  typename char_generator_type>
+char_type *read_or_generate(
+    const int argc,
+    char ** const argv,
+    std::uint64_t &text_length,
+    const std::uint64_t period,
+    const std::uint64_t mutation_rate,
+    char_generator_type random_char) {
+  char_type *text = NULL;
+  if (argc > 1) {
+    text_length = utils::file_size(argv[1]) / sizeof(char_type);
+    text = new char_type[text_length];
+    utils::read_from_file(text, text_length, argv[1]);
+  } else {
+    text = new char_type[text_length];
+    generate(text, text_length, period, mutation_rate, random_char);
+  }
+  if (text_length == 0) {
+    fprintf(stderr, "Error: the text is empty\n");
+    std::exit(EXIT_FAILURE);
+  }
+  return text;
+}
+
+}  // namespace test_text
+
+#endif  // __TEST_TEXT_HPP_INCLUDED
@@ -0,0 +1,8 @@
+rm -rf text_to_st_att
+make nuclear && make text_to_st_att
+for attractor in lz77 bwt lex greedy; do
+  rm -f "$1.$attractor.st_att"
+  ./text_to_st_att -b -a $attractor -o "$1.$attractor.st_att" "$1"
+  rm -f "$1.$attractor.st_att"
+done
+rm -rf text_to_st_att
@@ -0,0 +1,4 @@
+rm -rf query_scaling
+make nuclear && make query_scaling
+./query_scaling "$@"
+rm -rf query_scaling
@@ -0,0 +1,4 @@
+rm -rf rank_select
+make nuclear && make rank_select
+./rank_select "$@"
+rm -rf rank_select
@@ -0,0 +1,4 @@
+rm -rf rmq_benchmark
+make nuclear && make rmq_benchmark
+./rmq_benchmark "$@"
+rm -rf rmq_benchmark